@@ -0,0 +1,98 @@
+#include <network-monitor/file-downloader.h>
+#include <network-monitor/transport-network.h>
+
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using NetworkMonitor::ParseJsonFile;
+using NetworkMonitor::TransportNetwork;
+
+using Clock = std::chrono::steady_clock;
+
+// Get the peak resident memory of this process, in MiB.
+static double GetPeakMemoryMiB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters {};
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+    rusage usage {};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // macOS reports bytes, Linux reports KiB.
+    return usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    return usage.ru_maxrss / 1024.0;
+#endif
+#endif
+}
+
+// The peak memory of a process only grows, so we load the network once per
+// run. Run the benchmark once for each loader to compare them.
+// Usage: network-monitor-loading-benchmarks [dom|sax] [network-layout.json]
+int main(int argc, char* argv[])
+{
+    const std::string loader {argc > 1 ? argv[1] : "sax"};
+    const std::filesystem::path networkLayoutFile {
+        argc > 2 ? argv[2] : NETWORK_LAYOUT_JSON
+    };
+    if (loader != "dom" && loader != "sax") {
+        std::cerr << "Unknown loader: " << loader << std::endl;
+        return -1;
+    }
+
+    spdlog::set_level(spdlog::level::warn);
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Network layout: " << networkLayoutFile << " ("
+              << std::filesystem::file_size(networkLayoutFile) /
+                 (1024.0 * 1024.0)
+              << " MiB)\n";
+
+    const auto baseMemoryMiB {GetPeakMemoryMiB()};
+    TransportNetwork nw {};
+    bool ok {false};
+    const auto start {Clock::now()};
+    try {
+        if (loader == "dom") {
+            // ParseJsonFile returns an empty object on failure, which
+            // FromJson rejects.
+            ok = nw.FromJson(ParseJsonFile(networkLayoutFile));
+        } else {
+            ok = nw.FromJsonFile(networkLayoutFile);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Could not load the network layout: " << e.what()
+                  << std::endl;
+        return -1;
+    }
+    const auto end {Clock::now()};
+    if (!ok) {
+        std::cerr << "Could not load the travel times" << std::endl;
+        return -1;
+    }
+    const auto peakMemoryMiB {GetPeakMemoryMiB()};
+
+    std::cout << "Loader: " << loader << "\n"
+              << "  load time: "
+              << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms\n"
+              << "  peak memory: " << peakMemoryMiB << " MiB (+"
+              << peakMemoryMiB - baseMemoryMiB << " MiB while loading)\n";
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include <network-monitor/file-downloader.h>
+#include <network-monitor/transport-network.h>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using NetworkMonitor::ParseJsonFile;
+using NetworkMonitor::StationHandle;
+using NetworkMonitor::TransportNetwork;
+
+using Clock = std::chrono::steady_clock;
+
+// Get the time it takes to run a function, in milliseconds.
+static double GetRunTimeMs(
+    const std::function<void ()>& fn
+)
+{
+    const auto start {Clock::now()};
+    fn();
+    const auto end {Clock::now()};
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Get the average time of a fastest route query, in microseconds.
+static double GetQueryTimeUs(
+    const TransportNetwork& nw,
+    const std::vector<std::pair<StationHandle, StationHandle>>& queries
+)
+{
+    unsigned int totalTravelTime {0};
+    const auto runTimeMs {GetRunTimeMs([&nw, &queries, &totalTravelTime]() {
+        for (const auto& [stationA, stationB]: queries) {
+            totalTravelTime += nw.GetFastestTravelRoute(
+                stationA,
+                stationB
+            ).totalTravelTime;
+        }
+    })};
+
+    // We print the total travel time so that the compiler cannot skip the
+    // queries, and to check that all engines agree.
+    std::cout << "  total travel time: " << totalTravelTime << " min\n";
+    return runTimeMs * 1000 / queries.size();
+}
+
+// Usage: network-monitor-benchmarks [network-layout.json] [nQueries]
+int main(int argc, char* argv[])
+{
+    const std::filesystem::path networkLayoutFile {
+        argc > 1 ? argv[1] : NETWORK_LAYOUT_JSON
+    };
+    const size_t nQueries {argc > 2 ? std::stoul(argv[2]) : 10000};
+
+    // The route queries log at the info level, which would dominate the
+    // timings.
+    spdlog::set_level(spdlog::level::warn);
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    // Network loading
+    nlohmann::json networkLayout {};
+    const auto parseTimeMs {GetRunTimeMs(
+        [&networkLayout, &networkLayoutFile]() {
+            networkLayout = ParseJsonFile(networkLayoutFile);
+        }
+    )};
+    TransportNetwork nw {};
+    bool ok {false};
+    const auto loadTimeMs {GetRunTimeMs([&nw, &networkLayout, &ok]() {
+        ok = nw.FromJson(std::move(networkLayout));
+    })};
+    if (!ok) {
+        std::cerr << "Could not load the network layout: "
+                  << networkLayoutFile << std::endl;
+        return -1;
+    }
+    std::cout << "Network loading: " << loadTimeMs << " ms (+"
+              << parseTimeMs << " ms JSON parsing)\n";
+
+    // Snapshot loading, to compare with the JSON parsing and loading.
+    const auto snapshotFile {
+        std::filesystem::temp_directory_path() / "network-monitor-snapshot.bin"
+    };
+    if (!nw.SaveSnapshot(snapshotFile)) {
+        std::cerr << "Could not save the network snapshot: " << snapshotFile
+                  << std::endl;
+        return -1;
+    }
+    TransportNetwork nwSnapshot {};
+    const auto snapshotLoadTimeMs {GetRunTimeMs(
+        [&nwSnapshot, &snapshotFile, &ok]() {
+            ok = nwSnapshot.LoadSnapshot(snapshotFile);
+        }
+    )};
+    std::filesystem::remove(snapshotFile);
+    if (!ok) {
+        std::cerr << "Could not load the network snapshot: " << snapshotFile
+                  << std::endl;
+        return -1;
+    }
+    std::cout << "Snapshot loading: " << snapshotLoadTimeMs << " ms ("
+              << (parseTimeMs + loadTimeMs) / snapshotLoadTimeMs << "x)\n";
+
+    // Random station pairs, with a fixed seed so that runs are comparable.
+    StationHandle nStations {0};
+    while (nw.GetStationId(nStations) != "") {
+        ++nStations;
+    }
+    if (nStations == 0) {
+        std::cerr << "The network has no stations" << std::endl;
+        return -1;
+    }
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<StationHandle> stationDist(0, nStations - 1);
+    std::vector<std::pair<StationHandle, StationHandle>> queries {};
+    queries.reserve(nQueries);
+    for (size_t idx {0}; idx < nQueries; ++idx) {
+        queries.emplace_back(stationDist(rng), stationDist(rng));
+    }
+    std::cout << "Queries: " << nQueries << " random pairs of " << nStations
+              << " stations\n";
+
+    // Dijkstra's algorithm
+    TransportNetwork nwDijkstra {nw};
+    nwDijkstra.SetGoalDirectedSearch(false);
+    std::cout << "Dijkstra:\n";
+    const auto dijkstraQueryTimeUs {GetQueryTimeUs(nwDijkstra, queries)};
+    std::cout << "  query: " << dijkstraQueryTimeUs << " us\n";
+
+    // A* with landmarks
+    std::cout << "A* (landmarks):\n";
+    const auto aStarQueryTimeUs {GetQueryTimeUs(nw, queries)};
+    std::cout << "  query: " << aStarQueryTimeUs << " us ("
+              << dijkstraQueryTimeUs / aStarQueryTimeUs << "x)\n";
+
+    // Contraction Hierarchies
+    TransportNetwork nwIndexed {nw};
+    const auto indexTimeMs {GetRunTimeMs([&nwIndexed]() {
+        nwIndexed.PrecomputeContractionHierarchy();
+    })};
+    std::cout << "Contraction Hierarchies:\n"
+              << "  preprocessing: " << indexTimeMs << " ms\n"
+              << "  index size: "
+              << nwIndexed.GetContractionHierarchyMemoryUsage() / 1024.0
+              << " KiB\n";
+    const auto indexQueryTimeUs {GetQueryTimeUs(nwIndexed, queries)};
+    std::cout << "  query: " << indexQueryTimeUs << " us ("
+              << dijkstraQueryTimeUs / indexQueryTimeUs << "x)\n";
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef NETWORK_MONITOR_CONTRACTION_HIERARCHY_H
+#define NETWORK_MONITOR_CONTRACTION_HIERARCHY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace NetworkMonitor {
+
+/*! \brief Contraction Hierarchies index over a weighted directed graph.
+ *
+ *  The index contracts the graph nodes one at a time, in order of importance,
+ *  and adds shortcut arcs to preserve the shortest paths between the nodes
+ *  that are left. Shortest path queries then run a bidirectional Dijkstra
+ *  search that only moves upwards in the node order, and unpack the shortcuts
+ *  they find back into the original arcs.
+ *
+ *  The graph nodes are identified by their index, from 0 to nNodes - 1.
+ */
+class ContractionHierarchy {
+public:
+    /*! \brief A weighted directed arc between two graph nodes.
+     */
+    struct Arc {
+        std::uint32_t from {0};
+        std::uint32_t to {0};
+        unsigned int weight {0};
+    };
+
+    /*! \brief Marker for a node that cannot be reached.
+     */
+    static constexpr unsigned int kUnreachable {
+        std::numeric_limits<unsigned int>::max()
+    };
+
+    /*! \brief Default constructor
+     *
+     *  The default index is empty and has no nodes.
+     */
+    ContractionHierarchy();
+
+    /*! \brief Build the index for a graph.
+     *
+     *  Arcs that refer to nodes outside of the graph are ignored. Of many
+     *  parallel arcs between the same nodes, we only keep the lightest one.
+     */
+    ContractionHierarchy(
+        const size_t nNodes,
+        const std::vector<Arc>& arcs
+    );
+
+    /*! \brief Check if the index has no nodes.
+     */
+    bool IsEmpty() const;
+
+    /*! \brief Get the number of nodes in the indexed graph.
+     */
+    size_t GetNNodes() const;
+
+    /*! \brief Get the number of shortcut arcs added by the contraction.
+     */
+    size_t GetNShortcuts() const;
+
+    /*! \brief Get the memory used by the index, in bytes.
+     */
+    size_t GetMemoryUsage() const;
+
+    /*! \brief Get the shortest path between two nodes.
+     *
+     *  \param path On success, the nodes of the shortest path, from source to
+     *              target, both included. Cleared if there is no path.
+     *
+     *  \returns The length of the shortest path, or kUnreachable if there is no
+     *           path between the two nodes or if they are not in the graph.
+     *
+     *  This function can be called concurrently from multiple threads.
+     */
+    unsigned int GetShortestPath(
+        const std::uint32_t source,
+        const std::uint32_t target,
+        std::vector<std::uint32_t>& path
+    ) const;
+
+private:
+    // Marker for arcs that are not shortcuts.
+    static constexpr std::uint32_t kNoNode {
+        std::numeric_limits<std::uint32_t>::max()
+    };
+
+    // An arc of the upward search graphs, stored with its lower end node.
+    // Shortcuts remember the node they skip, to unpack them.
+    struct UpwardArc {
+        std::uint32_t node {0};
+        unsigned int weight {0};
+        std::uint32_t middle {kNoNode};
+    };
+
+    size_t nShortcuts_ {0};
+
+    // The upward graphs, in compressed sparse row format.
+    // - Forward: Arcs from each node to higher-ranked nodes.
+    // - Backward: Arcs to each node from higher-ranked nodes.
+    std::vector<std::uint32_t> forwardOffsets_ {};
+    std::vector<UpwardArc> forwardArcs_ {};
+    std::vector<std::uint32_t> backwardOffsets_ {};
+    std::vector<UpwardArc> backwardArcs_ {};
+
+    // Get the upward arc between two nodes, where `lower` has the lower rank.
+    const UpwardArc* FindArc(
+        const std::uint32_t lower,
+        const std::uint32_t upper,
+        const bool forward
+    ) const;
+
+    // Append the original nodes of an arc to a path, excluding `from`.
+    void UnpackArc(
+        const std::uint32_t from,
+        const std::uint32_t to,
+        const std::uint32_t middle,
+        std::vector<std::uint32_t>& path
+    ) const;
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_CONTRACTION_HIERARCHY_H
@@ -0,0 +1,249 @@
+#ifndef NETWORK_MONITOR_LRU_CACHE_H
+#define NETWORK_MONITOR_LRU_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace NetworkMonitor {
+
+/*! \brief Bounded key-value cache that evicts the least recently used entry.
+ *
+ *  All methods can be called concurrently from multiple threads. Lookups copy
+ *  the value under a lock, so values should be cheap to copy, like shared
+ *  pointers. A cache with no capacity takes no lock at all.
+ *
+ *  \tparam Key     The cache key. It must be copyable and equality-comparable.
+ *  \tparam Value   The cached value. It must be copyable.
+ *  \tparam Hash    Hash function object for the key.
+ */
+template <
+    typename Key,
+    typename Value,
+    typename Hash = std::hash<Key>
+>
+class LruCache {
+public:
+    /*! \brief Construct a cache that holds up to `capacity` entries.
+     *
+     *  A cache with no capacity never stores anything.
+     */
+    explicit LruCache(
+        const size_t capacity = 0
+    ) : capacity_ {capacity}
+    {
+    }
+
+    /*! \brief Copy constructor
+     *
+     *  The copy has the same entries and counters as the copied cache.
+     */
+    LruCache(
+        const LruCache& copied
+    )
+    {
+        std::lock_guard<std::mutex> lock {copied.mutex_};
+        CopyFrom(copied);
+    }
+
+    /*! \brief Copy assignment operator
+     */
+    LruCache& operator=(
+        const LruCache& copied
+    )
+    {
+        if (this != &copied) {
+            std::scoped_lock lock {mutex_, copied.mutex_};
+            CopyFrom(copied);
+        }
+        return *this;
+    }
+
+    /*! \brief Set the maximum number of entries.
+     *
+     *  If the cache holds more entries, we evict the least recently used ones.
+     */
+    void SetCapacity(
+        const size_t capacity
+    )
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+        capacity_ = capacity;
+        Evict();
+    }
+
+    /*! \brief Get the maximum number of entries.
+     */
+    size_t GetCapacity() const
+    {
+        return capacity_;
+    }
+
+    /*! \brief Get the number of entries.
+     */
+    size_t GetSize() const
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+        return entries_.size();
+    }
+
+    /*! \brief Look up a key.
+     *
+     *  On a hit, this entry becomes the most recently used one. Lookups in a
+     *  cache with no capacity always miss, and do not count as misses.
+     *
+     *  \param isValid  Entries for which this returns false count as misses,
+     *                  and we drop them. We call it without holding the lock,
+     *                  so it can be slow, and it can use the cache.
+     *
+     *  \returns true on a hit, with the cached value in `value`.
+     */
+    bool Get(
+        const Key& key,
+        Value& value,
+        const std::function<bool(const Value&)>& isValid = {}
+    )
+    {
+        if (capacity_ == 0) {
+            return false;
+        }
+
+        Value cached {};
+        std::uint64_t stamp {0};
+        {
+            std::lock_guard<std::mutex> lock {mutex_};
+            auto indexIt {index_.find(key)};
+            if (indexIt == index_.end()) {
+                ++nMisses_;
+                return false;
+            }
+            auto entryIt {indexIt->second};
+            entries_.splice(entries_.begin(), entries_, entryIt);
+            cached = entryIt->value;
+            stamp = entryIt->stamp;
+        }
+
+        // We only drop an invalid entry if nobody replaced it while we were
+        // checking it.
+        if (isValid && !isValid(cached)) {
+            std::lock_guard<std::mutex> lock {mutex_};
+            auto indexIt {index_.find(key)};
+            if (indexIt != index_.end() && indexIt->second->stamp == stamp) {
+                entries_.erase(indexIt->second);
+                index_.erase(indexIt);
+            }
+            ++nMisses_;
+            return false;
+        }
+        value = std::move(cached);
+        ++nHits_;
+        return true;
+    }
+
+    /*! \brief Add or replace the value of a key.
+     *
+     *  The entry becomes the most recently used one.
+     */
+    void Put(
+        const Key& key,
+        Value value
+    )
+    {
+        if (capacity_ == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock {mutex_};
+        auto indexIt {index_.find(key)};
+        if (indexIt != index_.end()) {
+            indexIt->second->value = std::move(value);
+            indexIt->second->stamp = ++lastStamp_;
+            entries_.splice(entries_.begin(), entries_, indexIt->second);
+            return;
+        }
+        entries_.push_front({key, std::move(value), ++lastStamp_});
+        index_.emplace(key, entries_.begin());
+        Evict();
+    }
+
+    /*! \brief Remove all entries. The counters are not affected.
+     */
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock {mutex_};
+        index_.clear();
+        entries_.clear();
+    }
+
+    /*! \brief Get the number of lookups that found a valid entry.
+     */
+    size_t GetNHits() const
+    {
+        return nHits_;
+    }
+
+    /*! \brief Get the number of lookups that did not find a valid entry.
+     */
+    size_t GetNMisses() const
+    {
+        return nMisses_;
+    }
+
+private:
+    // Each entry gets a new stamp every time we put a value in it.
+    struct Entry {
+        Key key;
+        Value value;
+        std::uint64_t stamp {0};
+    };
+    using Entries = std::list<Entry>;
+
+    // The mutex guards the entries. We can read the capacity and the counters
+    // without it.
+    mutable std::mutex mutex_ {};
+    std::atomic<size_t> capacity_ {0};
+
+    // Entries from the most to the least recently used, and their index by
+    // key.
+    Entries entries_ {};
+    std::unordered_map<Key, typename Entries::iterator, Hash> index_ {};
+    std::uint64_t lastStamp_ {0};
+
+    std::atomic<size_t> nHits_ {0};
+    std::atomic<size_t> nMisses_ {0};
+
+    // Copy the state of another cache. The caller holds both locks.
+    void CopyFrom(
+        const LruCache& copied
+    )
+    {
+        capacity_ = copied.capacity_.load();
+        entries_ = copied.entries_;
+        index_.clear();
+        for (auto entryIt {entries_.begin()}; entryIt != entries_.end();
+             ++entryIt) {
+            index_.emplace(entryIt->key, entryIt);
+        }
+        lastStamp_ = copied.lastStamp_;
+        nHits_ = copied.nHits_.load();
+        nMisses_ = copied.nMisses_.load();
+    }
+
+    // Evict the least recently used entries over capacity. The caller holds
+    // the lock.
+    void Evict()
+    {
+        while (entries_.size() > capacity_) {
+            index_.erase(entries_.back().key);
+            entries_.pop_back();
+        }
+    }
+};
+
+} // namespace NetworkMonitor
+
+#endif // NETWORK_MONITOR_LRU_CACHE_H
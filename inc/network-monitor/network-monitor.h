@@ -44,6 +44,11 @@ struct NetworkMonitorConfig {
     double quietRouteMaxSlowdownPc {0.1};
     double quietRouteMinQuietnessPc {0.1};
     size_t quietRouteMaxNPaths {20};
+
+    // If set, we load the network from this binary snapshot, and only fall
+    // back to the network layout file if the snapshot is missing or stale.
+    // We then write a fresh snapshot for the next launch.
+    std::filesystem::path networkSnapshotFile {};
 };
 
 /*! \brief Error codes for the Live Transport Network Monitor process.
@@ -121,53 +126,10 @@ public:
             return NetworkMonitorError::kMissingNetworkLayoutFile;
         }
 
-        // Download the network-layout.json file if the config does not contain
-        // a local filename, then parse the file.
-        auto networkLayoutFile {config.networkLayoutFile.empty() ?
-            std::filesystem::temp_directory_path() / "network-layout.json" :
-            config.networkLayoutFile
-        };
-        if (config.networkLayoutFile.empty()) {
-            spdlog::info(
-                "NetworkMonitor: Downloading the network layout file to {}",
-                networkLayoutFile
-            );
-            const std::string fileUrl {
-                "https://" + config.networkEventsUrl + networkLayoutEndpoint_
-            };
-            bool downloaded {DownloadFile(
-                fileUrl,
-                networkLayoutFile,
-                config.caCertFile
-            )};
-            if (!downloaded) {
-                spdlog::error("NetworkMonitor: Could not download {}. Exiting",
-                              fileUrl);
-                return NetworkMonitorError::kFailedNetworkLayoutFileDownload;
-            }
-        }
-        spdlog::info("NetworkMonitor: Loading the network layout file");
-        auto parsed = ParseJsonFile(networkLayoutFile);
-        if (parsed.empty()) {
-            spdlog::error("NetworkMonitor: Could not parse {}. Exiting",
-                          networkLayoutFile);
-            return NetworkMonitorError::kFailedNetworkLayoutFileParsing;
-        }
-
         // Network representation
-        spdlog::info("NetworkMonitor: Constructing the network representation");
-        try {
-            bool networkLoaded {network_.FromJson(std::move(parsed))};
-            if (!networkLoaded) {
-                spdlog::error("NetworkMonitor: Could not construct the "
-                              "TransportNetwork. Exiting");
-                return NetworkMonitorError::kFailedTransportNetworkConstruction;
-            }
-        } catch (const std::exception& e) {
-            spdlog::error("NetworkMonitor: Exception while constructing the "
-                          "TransportNetwork: {}. Exiting",
-                          e.what());
-            return NetworkMonitorError::kFailedTransportNetworkConstruction;
+        auto networkError {LoadNetwork(config)};
+        if (networkError != NetworkMonitorError::kOk) {
+            return networkError;
         }
 
         // STOMP client
@@ -359,6 +321,75 @@ private:
     const std::string subscriptionDestination_ {"/passengers"};
     const std::string quietRouteDestination {"/quiet-route"};
 
+    // Load the network from the snapshot or from the network layout file.
+    NetworkMonitorError LoadNetwork(
+        const NetworkMonitorConfig& config
+    )
+    {
+        // Load the network snapshot, if any.
+        if (!config.networkSnapshotFile.empty()) {
+            spdlog::info("NetworkMonitor: Loading the network snapshot {}",
+                         config.networkSnapshotFile);
+            if (network_.LoadSnapshot(config.networkSnapshotFile)) {
+                return NetworkMonitorError::kOk;
+            }
+            spdlog::warn("NetworkMonitor: Could not load the network "
+                         "snapshot. Loading the network layout instead");
+        }
+
+        // Download the network-layout.json file if the config does not contain
+        // a local filename, then parse the file.
+        auto networkLayoutFile {config.networkLayoutFile.empty() ?
+            std::filesystem::temp_directory_path() / "network-layout.json" :
+            config.networkLayoutFile
+        };
+        if (config.networkLayoutFile.empty()) {
+            spdlog::info(
+                "NetworkMonitor: Downloading the network layout file to {}",
+                networkLayoutFile
+            );
+            const std::string fileUrl {
+                "https://" + config.networkEventsUrl + networkLayoutEndpoint_
+            };
+            bool downloaded {DownloadFile(
+                fileUrl,
+                networkLayoutFile,
+                config.caCertFile
+            )};
+            if (!downloaded) {
+                spdlog::error("NetworkMonitor: Could not download {}. Exiting",
+                              fileUrl);
+                return NetworkMonitorError::kFailedNetworkLayoutFileDownload;
+            }
+        }
+        spdlog::info("NetworkMonitor: Loading the network layout file");
+        try {
+            bool networkLoaded {network_.FromJsonFile(networkLayoutFile)};
+            if (!networkLoaded) {
+                spdlog::error("NetworkMonitor: Could not construct the "
+                              "TransportNetwork. Exiting");
+                return NetworkMonitorError::kFailedTransportNetworkConstruction;
+            }
+        } catch (const nlohmann::json::exception& e) {
+            spdlog::error("NetworkMonitor: Could not parse {}: {}. Exiting",
+                          networkLayoutFile, e.what());
+            return NetworkMonitorError::kFailedNetworkLayoutFileParsing;
+        } catch (const std::exception& e) {
+            spdlog::error("NetworkMonitor: Exception while constructing the "
+                          "TransportNetwork: {}. Exiting",
+                          e.what());
+            return NetworkMonitorError::kFailedTransportNetworkConstruction;
+        }
+
+        // Write a snapshot for the next launch.
+        if (!config.networkSnapshotFile.empty() &&
+                !network_.SaveSnapshot(config.networkSnapshotFile)) {
+            spdlog::warn("NetworkMonitor: Could not write the network "
+                         "snapshot {}", config.networkSnapshotFile);
+        }
+        return NetworkMonitorError::kOk;
+    }
+
     // Handlers
 
     void OnNetworkEventsConnect(
@@ -1,16 +1,26 @@
 #ifndef NETWORK_MONITOR_TRANSPORT_NETWORK_H
 #define NETWORK_MONITOR_TRANSPORT_NETWORK_H
 
+#include <network-monitor/contraction-hierarchy.h>
+#include <network-monitor/lru-cache.h>
+
+#include <boost/asio/thread_pool.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <nlohmann/json.hpp>
 
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <ostream>
 #include <string>
+#include <string_view>
+#include <tuple>
 #include <unordered_map>
-#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -20,6 +30,34 @@ namespace NetworkMonitor {
  */
 using Id = std::string;
 
+/*! \brief A dense handle to a station in a TransportNetwork.
+ *
+ *  Handles are assigned in the order in which stations are added to the
+ *  network and are only meaningful for the network that issued them. Callers
+ *  that issue many queries can resolve station IDs to handles once and use the
+ *  handle-based overloads of the TransportNetwork methods.
+ */
+using StationHandle = std::uint32_t;
+
+/*! \brief A station handle that does not refer to any station.
+ */
+constexpr StationHandle kInvalidStationHandle {
+    std::numeric_limits<StationHandle>::max()
+};
+
+/*! \brief Travel time between two stations with no route between them.
+ */
+constexpr unsigned int kUnreachableTravelTime {
+    std::numeric_limits<unsigned int>::max()
+};
+
+/*! \brief A dense handle to a line route in a TransportNetwork.
+ *
+ *  Like station handles, route handles are assigned in the order in which
+ *  routes are added to the network.
+ */
+using RouteHandle = std::uint32_t;
+
 /*! \brief Network station
  *
  *  A Station struct is well formed if:
@@ -91,6 +129,9 @@ struct Line {
 };
 
 /*! \brief Passenger event
+ *
+ *  If `routeId` is not empty, the passengers get on or off that route at the
+ *  station, which must serve the station.
  */
 struct PassengerEvent {
     enum class Type {
@@ -101,6 +142,7 @@ struct PassengerEvent {
     Id stationId {};
     Type type {Type::In};
     boost::posix_time::ptime timestamp {};
+    Id routeId {};
 };
 
 void from_json(
@@ -168,7 +210,72 @@ void from_json(
     TravelRoute& dst
 );
 
+/*! \brief A station we can reach from a start station, with the travel time
+ *         of the fastest route to it.
+ *
+ *  Among the fastest routes, we count the route changes of the one with the
+ *  fewest.
+ */
+struct ReachableStation {
+    Id stationId {};
+    unsigned int travelTime {0};
+    unsigned int nRouteChanges {0};
+
+    bool operator==(const ReachableStation& other) const;
+};
+
+/*! \brief Search algorithm for the quiet travel routes.
+ */
+enum class QuietRouteSearch {
+    /*! Enumerate the fastest routes by travel time, with Yen's algorithm, and
+     *  pick the most quiet one among them.
+     */
+    kYen,
+
+    /*! Search the routes that are best in both travel time and crowding
+     *  (Pareto-optimal) in a single pass, and pick the most quiet one.
+     */
+    kPareto,
+
+    /*! Minimize the route crowding under the travel time limit with a
+     *  Lagrangian relaxation, which combines travel time and crowding in a
+     *  single route cost. Each iteration is one fastest route search, but the
+     *  route may not be the most quiet one.
+     */
+    kLagrangian,
+};
+
+/*! \brief Model of the station crowding for the quiet travel routes.
+ *
+ *  The crowding of a travel route is the sum of the crowding at each of its
+ *  stops. A stop counts the passenger events at its station with no route,
+ *  plus the events on the route we ride to the stop, or that we board at the
+ *  first stop.
+ */
+enum class CrowdingModel {
+    /*! All passengers in minus all passengers out since we started recording
+     *  passenger events.
+     */
+    kCumulative,
+
+    /*! Passengers in minus passengers out, where each passenger event counts
+     *  less the older it is, with an exponential decay. The age of an event is
+     *  its distance from the latest event timestamp.
+     */
+    kDecayed,
+};
+
 /*! \brief Underground network representation
+ *
+ *  Route queries can run on many threads while another thread changes the
+ *  network layout, travel times or search settings: Queries work on an
+ *  immutable snapshot of the network graph and its settings, which changes
+ *  replace atomically. Changes must not run concurrently with each other.
+ *  The thread pool setters, SetQuietRouteSearchThreads and
+ *  SetBatchQueryThreads, must not run concurrently with the queries either.
+ *
+ *  Passenger events can be recorded from any number of threads, concurrently
+ *  with the route queries, but not with the changes to the network layout.
  */
 class TransportNetwork {
 public:
@@ -213,7 +320,8 @@ public:
      *
      *  \throws std::runtime_error This method throws if the JSON items were
      *                             parsed correctly but there was an issue
-     *                             adding new stations or lines to the network.
+     *                             adding new stations or lines to the network,
+     *                             or if a travel time is not an unsigned int.
      *  \throws nlohmann::json::exception If there was a problem parsing the
      *                                    JSON object.
      */
@@ -221,6 +329,70 @@ public:
         nlohmann::json&& src
     );
 
+    /*! \brief Populate the network from a network layout JSON file.
+     *
+     *  Unlike FromJson, this method does not parse the file into a JSON
+     *  object. We stream the file and add each station as soon as we parse
+     *  it. We only hold on to the lines and travel times that come before the
+     *  items they depend on.
+     *
+     *  \returns false if stations and lines were parsed successfully, but not
+     *           the travel times.
+     *
+     *  \throws std::runtime_error This method throws if we could not open the
+     *                             file, if an item misses a field, if a travel
+     *                             time is not an unsigned int, or if there was
+     *                             an issue adding new stations or lines to the
+     *                             network.
+     *  \throws nlohmann::json::exception If the file is not valid JSON.
+     */
+    bool FromJsonFile(
+        const std::filesystem::path& file
+    );
+
+    /*! \brief Populate the network from a network layout JSON buffer.
+     *
+     *  This method streams the buffer like FromJsonFile does, and it throws
+     *  the same exceptions.
+     *
+     *  \returns false if stations and lines were parsed successfully, but not
+     *           the travel times.
+     */
+    bool FromJsonBuffer(
+        std::string_view src
+    );
+
+    /*! \brief Save the network to a binary snapshot file.
+     *
+     *  The snapshot holds the stations, lines, routes and travel times, and
+     *  the search graph we build from them, as flat arrays. Passenger counts
+     *  are not saved. We write the snapshot to a temporary file first, so that
+     *  readers never see a partial snapshot.
+     *
+     *  \returns false if we could not write the file.
+     */
+    bool SaveSnapshot(
+        const std::filesystem::path& file
+    ) const;
+
+    /*! \brief Populate an empty network from a binary snapshot file.
+     *
+     *  We map the file in memory and copy its arrays as they are, with no
+     *  parsing. We reject snapshots with a different layout version or byte
+     *  order, and snapshots that fail their checksum.
+     *
+     *  Queries do not read the mapped file: We copy the search graph out of
+     *  it, and still rebuild the stations, lines and routes that updates work
+     *  on. Loading a snapshot skips the JSON parsing and the search graph
+     *  build, but still takes time in proportion to the network size.
+     *
+     *  \returns false if the network is not empty, or if the snapshot is
+     *           missing, stale or corrupt. The network stays empty then.
+     */
+    bool LoadSnapshot(
+        const std::filesystem::path& file
+    );
+
     /*! \brief Add a station to the network.
      *
      *  \returns false if there was an error while adding the station to the
@@ -258,6 +430,9 @@ public:
     );
 
     /*! \brief Get the number of passengers currently recorded at a station.
+     *
+     *  The count includes the passengers recorded on any route serving the
+     *  station.
      *
      *  The returned number can be negative: This happens if we start recording
      *  in the middle of the day and we record more exiting than entering
@@ -281,6 +456,18 @@ public:
         const Id& station
     ) const;
 
+    /*! \brief Get list of routes serving a given station.
+     *
+     *  This overload skips the station ID lookup. Use GetRouteId to get the
+     *  route IDs.
+     *
+     *  \returns An empty list if the handle does not refer to any station in
+     *           the network, or if the station has no routes serving it.
+     */
+    std::vector<RouteHandle> GetRoutesServingStation(
+        const StationHandle station
+    ) const;
+
     /*! \brief Set the travel time between 2 adjacent stations.
      *
      *  \returns false if there was an error while setting the travel time
@@ -333,6 +520,179 @@ public:
         const Id& stationB
     ) const;
 
+    /*! \brief Enable or disable the goal-directed route search.
+     *
+     *  When enabled (the default), route searches use the A* algorithm, guided
+     *  by travel time lower bounds precomputed from a set of landmark
+     *  stations, and only explore the part of the network they need to prove
+     *  that a route is the fastest one. When disabled, route searches use
+     *  plain Dijkstra's algorithm. Both modes return the same routes.
+     *
+     *  Queries that are already running keep the previous mode.
+     */
+    void SetGoalDirectedSearch(
+        const bool enabled
+    );
+
+    /*! \brief Set the travel time penalty for changing route at a station.
+     *
+     *  Route searches add this penalty, in minutes, every time a route changes
+     *  to a different route. The default is 5 minutes.
+     */
+    void SetRouteChangePenalty(
+        const unsigned int penalty
+    );
+
+    /*! \brief Get the travel time penalty for changing route at a station.
+     */
+    unsigned int GetRouteChangePenalty() const;
+
+    /*! \brief Set the number of threads for the quiet route search.
+     *
+     *  The quiet route search finds alternative routes by searching the
+     *  network again from each stop of the last route it found. With more
+     *  than one thread, these searches run in parallel on a thread pool,
+     *  which copies of this network share. Results do not change. The
+     *  default, 1, runs all searches on the calling thread.
+     *
+     *  Do not call this while queries are running.
+     */
+    void SetQuietRouteSearchThreads(
+        const size_t nThreads
+    );
+
+    /*! \brief Set the number of threads for the batch route queries.
+     *
+     *  Batch queries run on a thread pool, which copies of this network share.
+     *  By default, all networks share a pool with one thread per core, which
+     *  we create on the first batch query that needs it. Batches of up to 64
+     *  queries always run on the calling thread.
+     *
+     *  Do not call this while queries are running.
+     */
+    void SetBatchQueryThreads(
+        const size_t nThreads
+    );
+
+    /*! \brief Set the maximum number of travel routes to cache.
+     *
+     *  GetFastestTravelRoute and GetQuietTravelRoute keep their most recently
+     *  used answers in a cache, keyed by their parameters. Fastest routes stay
+     *  valid until the network or its travel times change. Quiet routes also
+     *  become stale at the next passenger event. The default, 0, disables the
+     *  cache.
+     */
+    void SetRouteCacheCapacity(
+        const size_t capacity
+    );
+
+    /*! \brief Set the half-life of the passenger events in the kDecayed
+     *         crowding model.
+     *
+     *  The default is 15 minutes.
+     */
+    void SetCrowdingHalfLife(
+        const boost::posix_time::time_duration& halfLife
+    );
+
+    /*! \brief Set how much crowding can change before a cached quiet route
+     *         becomes stale.
+     *
+     *  With a tolerance, the cache keeps the candidate paths of each quiet
+     *  route, and reuses the route while the crowding of every candidate path
+     *  is within `tolerancePc` of its value when we found the route, relative
+     *  to that value. The default, 0, drops cached quiet routes at the next
+     *  passenger event.
+     *
+     *  The tolerance only applies to QuietRouteSearch::kYen, which keeps all
+     *  the paths within the allowed slowdown. The other searches only find the
+     *  fastest path and one quiet path, and a change in crowding can make
+     *  another path the quiet one, so we drop their cached routes at the next
+     *  passenger event.
+     *
+     *  Changing the tolerance drops all cached routes.
+     */
+    void SetQuietRouteCrowdingTolerance(
+        const double tolerancePc
+    );
+
+    /*! \brief Get the number of travel route queries answered by the cache.
+     */
+    size_t GetRouteCacheHits() const;
+
+    /*! \brief Get the number of travel route queries the cache could not
+     *         answer.
+     */
+    size_t GetRouteCacheMisses() const;
+
+    /*! \brief Precompute the fastest travel routes between all pairs of
+     *         stations.
+     *
+     *  After this call, GetFastestTravelRoute looks up its answers in a
+     *  table instead of searching the network, and only takes time
+     *  proportional to the length of the route. The table takes memory
+     *  proportional to the number of stations times the number of stations and
+     *  route segments, and we calculate it in parallel across all stations,
+     *  on the batch query thread pool.
+     *
+     *  This call builds the table straight away. Network changes drop the
+     *  table, and the first query on the changed network that can use it
+     *  builds it again. Until it is ready, queries search the network. Changes
+     *  never wait for the table, and a burst of changes only pays for one
+     *  rebuild.
+     */
+    void PrecomputeFastestTravelRoutes();
+
+    /*! \brief Precompute a Contraction Hierarchies index for the fastest route
+     *         search.
+     *
+     *  After this call, GetFastestTravelRoute answers with a bidirectional
+     *  search on the index, which only explores a small part of the network.
+     *  The index covers route changes and their penalty, so travel times do
+     *  not change. Among equally fast routes, the index may pick a different
+     *  one than the network search.
+     *
+     *  The all-pairs table of PrecomputeFastestTravelRoutes, if any, takes
+     *  precedence. Like that table, this call builds the index straight away,
+     *  and after a network change, the first query that can use the index
+     *  builds it again.
+     */
+    void PrecomputeContractionHierarchy();
+
+    /*! \brief Get the memory used by the Contraction Hierarchies index, in
+     *         bytes.
+     *
+     *  \returns 0 if the index has not been built, or has not been built
+     *           again since the last network change.
+     */
+    size_t GetContractionHierarchyMemoryUsage() const;
+
+    /*! \brief Get the handle of a station.
+     *
+     *  \returns kInvalidStationHandle if the station is not in the network.
+     */
+    StationHandle LookupStation(
+        const Id& station
+    ) const;
+
+    /*! \brief Get the ID of a station from its handle.
+     *
+     *  \returns An empty ID if the handle does not refer to any station in the
+     *           network.
+     */
+    Id GetStationId(
+        const StationHandle station
+    ) const;
+
+    /*! \brief Get the ID of a route from its handle.
+     *
+     *  \returns An empty ID if the handle does not refer to any route in the
+     *           network.
+     */
+    Id GetRouteId(
+        const RouteHandle route
+    ) const;
+
     /*! \brief Get the fastest travel route from station A to station B.
      */
     TravelRoute GetFastestTravelRoute(
@@ -340,6 +700,15 @@ public:
         const Id& stationB
     ) const;
 
+    /*! \brief Get the fastest travel route from station A to station B.
+     *
+     *  This overload skips the station ID lookup.
+     */
+    TravelRoute GetFastestTravelRoute(
+        const StationHandle stationA,
+        const StationHandle stationB
+    ) const;
+
     /*! \brief Get a quiet travel route alternative to the fastest route, from
      *         station A to station B.
      *
@@ -349,13 +718,137 @@ public:
      *                          quiet route worth the travel time increase.
      *  \param maxNPaths        Maximum number of paths to explore. If set,
      *                          this method may yield suboptimal results.
+     *                          Only the kYen search uses it.
+     *  \param search           Search algorithm. The kPareto search always
+     *                          finds the most quiet route within the travel
+     *                          time limit. The kLagrangian search is often
+     *                          faster but may miss it.
+     *  \param model            Crowding model to compare the routes with.
      */
     TravelRoute GetQuietTravelRoute(
         const Id& stationA,
         const Id& stationB,
         const double maxSlowdownPc,
         const double minQuietnessPc,
-        const size_t maxNPaths = std::numeric_limits<size_t>::max()
+        const size_t maxNPaths = std::numeric_limits<size_t>::max(),
+        const QuietRouteSearch search = QuietRouteSearch::kYen,
+        const CrowdingModel model = CrowdingModel::kCumulative
+    ) const;
+
+    /*! \brief Get a quiet travel route alternative to the fastest route, from
+     *         station A to station B.
+     *
+     *  This overload skips the station ID lookup.
+     */
+    TravelRoute GetQuietTravelRoute(
+        const StationHandle stationA,
+        const StationHandle stationB,
+        const double maxSlowdownPc,
+        const double minQuietnessPc,
+        const size_t maxNPaths = std::numeric_limits<size_t>::max(),
+        const QuietRouteSearch search = QuietRouteSearch::kYen,
+        const CrowdingModel model = CrowdingModel::kCumulative
+    ) const;
+
+    /*! \brief Get the fastest travel routes for a batch of (station A,
+     *         station B) pairs.
+     *
+     *  The queries run in parallel on the batch query thread pool. The routes
+     *  are in the same order as the queries.
+     */
+    std::vector<TravelRoute> GetFastestTravelRoutes(
+        const std::vector<std::pair<Id, Id>>& queries
+    ) const;
+
+    /*! \brief Get the fastest travel routes for a batch of (station A,
+     *         station B) pairs.
+     *
+     *  This overload skips the station ID lookup.
+     */
+    std::vector<TravelRoute> GetFastestTravelRoutes(
+        const std::vector<std::pair<StationHandle, StationHandle>>& queries
+    ) const;
+
+    /*! \brief Get the travel times of the fastest routes from each source
+     *         station to each target station.
+     *
+     *  We run one search from each source station, which stops once it has
+     *  reached all the targets, so this is much faster than calling
+     *  GetFastestTravelRoute for each pair. The searches run in parallel on
+     *  the batch query thread pool.
+     *
+     *  \returns A row-major matrix with one row per source and one column per
+     *           target. Station pairs with no route between them, or with an
+     *           invalid station, get kUnreachableTravelTime.
+     */
+    std::vector<unsigned int> GetTravelTimeMatrix(
+        const std::vector<Id>& sources,
+        const std::vector<Id>& targets
+    ) const;
+
+    /*! \brief Get the travel times of the fastest routes from each source
+     *         station to each target station.
+     *
+     *  This overload skips the station ID lookup.
+     */
+    std::vector<unsigned int> GetTravelTimeMatrix(
+        const std::vector<StationHandle>& sources,
+        const std::vector<StationHandle>& targets
+    ) const;
+
+    /*! \brief Get all stations we can reach from a station within a travel
+     *         time budget (isochrone).
+     *
+     *  A single search finds all the stations, and stops as soon as the
+     *  travel time goes over the budget.
+     *
+     *  \returns The reachable stations, including the start station, sorted by
+     *           travel time. An empty vector if the station is not in the
+     *           network.
+     */
+    std::vector<ReachableStation> GetReachableStations(
+        const Id& station,
+        const unsigned int maxTravelTime
+    ) const;
+
+    /*! \brief Get all stations we can reach from a station within a travel
+     *         time budget (isochrone).
+     *
+     *  This overload skips the station ID lookup.
+     */
+    std::vector<ReachableStation> GetReachableStations(
+        const StationHandle station,
+        const unsigned int maxTravelTime
+    ) const;
+
+    /*! \brief Get the quiet travel routes for a batch of (station A,
+     *         station B) pairs.
+     *
+     *  All queries share the same parameters, as in GetQuietTravelRoute. The
+     *  queries run in parallel on the batch query thread pool. The routes are
+     *  in the same order as the queries.
+     */
+    std::vector<TravelRoute> GetQuietTravelRoutes(
+        const std::vector<std::pair<Id, Id>>& queries,
+        const double maxSlowdownPc,
+        const double minQuietnessPc,
+        const size_t maxNPaths = std::numeric_limits<size_t>::max(),
+        const QuietRouteSearch search = QuietRouteSearch::kYen,
+        const CrowdingModel model = CrowdingModel::kCumulative
+    ) const;
+
+    /*! \brief Get the quiet travel routes for a batch of (station A,
+     *         station B) pairs.
+     *
+     *  This overload skips the station ID lookup.
+     */
+    std::vector<TravelRoute> GetQuietTravelRoutes(
+        const std::vector<std::pair<StationHandle, StationHandle>>& queries,
+        const double maxSlowdownPc,
+        const double minQuietnessPc,
+        const size_t maxNPaths = std::numeric_limits<size_t>::max(),
+        const QuietRouteSearch search = QuietRouteSearch::kYen,
+        const CrowdingModel model = CrowdingModel::kCumulative
     ) const;
 
 private:
@@ -370,9 +863,14 @@ private:
     struct GraphNode {
         Id id {};
         std::string name {};
-        long long int passengerCount {0};
         std::vector<std::shared_ptr<GraphEdge>> edges {};
 
+        // Routes serving the station, including the routes that end here.
+        std::vector<RouteHandle> routes {};
+
+        // Position of the station in the compact graph representation.
+        std::uint32_t index {0};
+
         // Find the edge for a specific line route.
         std::vector<
             std::shared_ptr<GraphEdge>
@@ -395,6 +893,9 @@ private:
         Id id {};
         std::shared_ptr<LineInternal> line {nullptr};
         std::vector<std::shared_ptr<GraphNode>> stops {};
+
+        // Position of the route in the compact graph representation.
+        std::uint32_t index {0};
     };
 
     // Internal line representation
@@ -403,53 +904,499 @@ private:
         Id id {};
         std::string name {};
         std::unordered_map<Id, std::shared_ptr<RouteInternal>> routes {};
+
+        // Position of the line in the compact graph representation.
+        std::uint32_t index {0};
+    };
+
+    // Number of landmarks we use for the goal-directed search.
+    static constexpr size_t kNLandmarks {8};
+
+    // Maximum number of Lagrangian multiplier updates in a quiet route search.
+    static constexpr size_t kMaxLagrangianIterations {32};
+
+    // Default travel time penalty for changing route at a station.
+    static constexpr unsigned int kDefaultRouteChangePenalty {5};
+
+    // Marker for a station that cannot be reached.
+    static constexpr unsigned int kUnreachable {
+        std::numeric_limits<unsigned int>::max()
+    };
+
+    // Marker for a path stop that was not reached through any edge, i.e. the
+    // path starting point.
+    static constexpr std::uint32_t kNoEdge {
+        std::numeric_limits<std::uint32_t>::max()
+    };
+
+    // Size of a CPU cache line, in bytes.
+    static constexpr size_t kCacheLineSize {64};
+
+    // Passenger counts by station handle and by route stop
+    // The counts are atomic counters in contiguous arrays, so that one thread
+    // can record passenger events while others read the counts to score
+    // routes, without locking. We pack the counters in blocks of one cache
+    // line each.
+    // The station counts only include the events with no route. The events on
+    // a route go to the counter of the route stop instead.
+    // Next to the cumulative counts, we keep exponentially decayed counts.
+    // Each decayed count packs its value, as a float, with the time of its
+    // last update, in seconds, so that we can read and update both at once.
+    // The arrays have a fixed size: To make room for new stations or routes,
+    // we copy the counts to larger arrays.
+    class PassengerCounts {
+    public:
+        PassengerCounts() = default;
+
+        // Make a copy of the counts with room for nStations stations and
+        // nRouteStops route stops.
+        PassengerCounts(
+            const PassengerCounts& copied,
+            const size_t nStations,
+            const size_t nRouteStops
+        );
+
+        size_t GetNStations() const;
+
+        size_t GetNRouteStops() const;
+
+        // Add a (possibly negative) number of passengers at a station, at a
+        // given time in seconds.
+        void Add(
+            const std::uint32_t station,
+            const long long int nPassengers,
+            const std::uint32_t time
+        );
+
+        // Add a (possibly negative) number of passengers at a route stop, at a
+        // given time in seconds.
+        void AddAtRouteStop(
+            const std::uint32_t routeStop,
+            const long long int nPassengers,
+            const std::uint32_t time
+        );
+
+        long long int Get(
+            const std::uint32_t station
+        ) const;
+
+        long long int GetAtRouteStop(
+            const std::uint32_t routeStop
+        ) const;
+
+        // Get the decayed count of a station at the latest event time.
+        double GetDecayed(
+            const std::uint32_t station
+        ) const;
+
+        // Get the decayed count of a route stop at the latest event time.
+        double GetDecayedAtRouteStop(
+            const std::uint32_t routeStop
+        ) const;
+
+        // Get the latest event time, in seconds.
+        std::uint32_t GetLatestTime() const;
+
+        // Set the half-life of the decayed counts, in seconds.
+        void SetHalfLife(
+            const double halfLife
+        );
+
+        // Get the number of changes to the counts so far.
+        std::uint64_t GetEpoch() const;
+
+    private:
+        template <typename T>
+        struct alignas(kCacheLineSize) Block {
+            static constexpr size_t kSize {
+                kCacheLineSize / sizeof(std::atomic<T>)
+            };
+            std::atomic<T> counters[kSize] {};
+        };
+
+        // Cumulative and decayed counters, for a given number of items.
+        struct Counters {
+            size_t size {0};
+            std::vector<Block<long long int>> counts {};
+            std::vector<Block<std::uint64_t>> decayedCounts {};
+
+            Counters() = default;
+
+            // Make a copy of the counters with room for nItems items.
+            Counters(
+                const Counters& copied,
+                const size_t nItems
+            );
+
+            std::atomic<long long int>& GetCount(
+                const std::uint32_t idx
+            );
+
+            const std::atomic<long long int>& GetCount(
+                const std::uint32_t idx
+            ) const;
+
+            std::atomic<std::uint64_t>& GetDecayedCount(
+                const std::uint32_t idx
+            );
+
+            const std::atomic<std::uint64_t>& GetDecayedCount(
+                const std::uint32_t idx
+            ) const;
+        };
+
+        Counters stationCounters_ {};
+        Counters routeStopCounters_ {};
+        std::atomic<std::uint32_t> latestTime_ {0};
+        std::atomic<double> halfLife_ {15 * 60};
+        std::atomic<std::uint64_t> epoch_ {0};
+
+        // Add a number of passengers to one of the counters.
+        void AddTo(
+            Counters& counters,
+            const std::uint32_t idx,
+            const long long int nPassengers,
+            const std::uint32_t time
+        );
+
+        // Get one of the decayed counters at the latest event time.
+        double GetDecayedFrom(
+            const Counters& counters,
+            const std::uint32_t idx
+        ) const;
+
+        // Get the fraction of a decayed count left after some time.
+        double GetDecay(
+            const std::uint32_t elapsed
+        ) const;
+    };
+
+    // Indexes of a graph that only queries need
+    // They take much longer to build than the graph, so we do not build them
+    // when the network changes. The first query on a graph that can use them
+    // builds them, and the other queries search the graph until they are
+    // ready. See GetGraphIndexes.
+    struct GraphIndexes {
+        // All-pairs fastest paths
+        // For each origin station, we store the search tree of a full search
+        // from it: the travel time to each state and the state it was reached
+        // from. For each origin and destination station, we also store the
+        // state the fastest path arrives at, or kNoEdge if there is no path.
+        // The arrays are origin-major: allPairsDistFromA[origin * nStates +
+        // state], allPairsLastState[origin * nStations + station].
+        std::vector<unsigned int> allPairsDistFromA {};
+        std::vector<std::uint32_t> allPairsPreviousState {};
+        std::vector<std::uint32_t> allPairsLastState {};
+
+        // Contraction Hierarchies index
+        // The index nodes are the states of the route-expanded graph, followed
+        // by an arrival node for each station, which all the route states of
+        // the station lead to.
+        ContractionHierarchy contractionHierarchy {};
+
+        // We set these flags once the matching index is built, and never
+        // change the index after that.
+        std::atomic<bool> hasAllPairs {false};
+        std::atomic<bool> hasContractionHierarchy {false};
+
+        // Only one query builds the indexes at a time.
+        std::mutex buildMutex {};
+    };
+
+    // Compact graph representation
+    // The GraphNode/GraphEdge objects are convenient to build and modify the
+    // network, but they are scattered across the heap. Our path-finding
+    // algorithms use this frozen, compressed-sparse-row copy of the network
+    // instead, where stations, routes and edges are referred to by their index.
+    // We rebuild it every time the network topology changes.
+    struct Graph {
+        // Incremented every time we publish a new graph.
+        std::uint64_t version {0};
+
+        struct Edge {
+            std::uint32_t nextStop {0};
+            std::uint32_t route {0};
+            unsigned int travelTime {0};
+        };
+
+        // The edges leaving station idx are stored in
+        // edges[edgeOffsets[idx], edgeOffsets[idx + 1]), in the same order as
+        // in GraphNode::edges.
+        std::vector<std::uint32_t> edgeOffsets {0};
+        std::vector<Edge> edges {};
+
+        // Line served by each route.
+        std::vector<std::uint32_t> routeLines {};
+
+        // Route-expanded graph
+        // Our path-finding algorithms search this graph of states, where each
+        // state is a station served by a route, on which we ride. Each station
+        // also has a departure state, where the paths that start there begin.
+        // States have two types of arcs:
+        // - Ride arcs follow an edge to the next station on the same route.
+        // - Transfer arcs change route at a station. They carry the route
+        //   change penalty, except when they leave a departure state.
+        // The arcs leaving state idx are stored in
+        // stateArcs[stateArcOffsets[idx], stateArcOffsets[idx + 1]).
+        struct StateArc {
+            std::uint32_t nextState {0};
+            unsigned int travelTime {0};
+            // kNoEdge for transfer arcs.
+            std::uint32_t edge {kNoEdge};
+        };
+        size_t nRouteStates {0};
+        std::vector<std::uint32_t> stateStations {};
+        // Penalty of the transfer arcs. Queries must use this one, and not the
+        // network setting, which may have changed since we built the graph.
+        unsigned int routeChangePenalty {kDefaultRouteChangePenalty};
+        // Route state we reach through each edge.
+        std::vector<std::uint32_t> edgeStates {};
+        std::vector<std::uint32_t> stateArcOffsets {0};
+        std::vector<StateArc> stateArcs {};
+
+        // Interning tables
+        // The index of a station, line or route is also its handle. We only
+        // resolve IDs at the API boundary, so that our algorithms only ever
+        // compare and hash integers.
+        std::unordered_map<Id, std::uint32_t> stationHandles {};
+        std::vector<Id> stationIds {};
+        std::vector<Id> lineIds {};
+        std::unordered_map<Id, std::uint32_t> lineHandles {};
+        std::vector<Id> routeIds {};
+        std::unordered_map<Id, std::uint32_t> routeHandles {};
+
+        // Route stops
+        // Each stop of each route has its own passenger counter. The stops of
+        // route idx take the counters from routeStopOffsets[idx], in route
+        // order. Routes never change once in the network, so their counters
+        // stay the same across graphs.
+        // We find the route stop of a station and route from the key (route <<
+        // 32 | station), and the one of each route state directly. For the
+        // stations a route stops at more than once, the key finds the first
+        // stop.
+        std::vector<std::uint32_t> routeStopOffsets {0};
+        std::unordered_map<std::uint64_t, std::uint32_t> routeStops {};
+        std::vector<std::uint32_t> stateRouteStops {};
+
+        // Travel time from the start of its route to each route stop.
+        std::vector<unsigned int> routeStopTravelTimes {};
+
+        // Routes serving each station.
+        std::vector<std::vector<RouteHandle>> stationRoutes {};
+
+        // Passenger counts
+        // Successive graphs share the same counts, which keep changing.
+        std::shared_ptr<PassengerCounts> passengerCounts {
+            std::make_shared<PassengerCounts>()
+        };
+
+        // Landmark distances (ALT)
+        // For each station and landmark, we store the travel time from the
+        // landmark to the station and from the station to the landmark,
+        // ignoring route changes. The triangle inequality turns them into
+        // lower bounds for the travel time between any two stations.
+        // The arrays are station-major: landmarkDistFrom[station * nLandmarks
+        // + landmark].
+        std::vector<std::uint32_t> landmarks {};
+        std::vector<unsigned int> landmarkDistFrom {};
+        std::vector<unsigned int> landmarkDistTo {};
+
+        // Query settings
+        // Queries must use these, and not the network settings, which the
+        // setters change while queries run. The setters publish a copy of the
+        // graph instead.
+        bool goalDirectedSearch {true};
+        // Quiet routes cached at an earlier crowding epoch are stale, unless
+        // their crowding is within this tolerance.
+        double quietRouteCrowdingTolerancePc {0.0};
+
+        // Indexes (optional)
+        // The copies of a graph that only change its settings share its
+        // indexes.
+        bool withAllPairs {false};
+        bool withContractionHierarchy {false};
+        std::shared_ptr<GraphIndexes> indexes {
+            std::make_shared<GraphIndexes>()
+        };
     };
 
     // A PathStop object represents a stop and the network edge to get to it.
     // We use it internally in our path-finding algorithms.
+    // Both the station and the edge are indices into the Graph object.
     struct PathStop {
-        std::shared_ptr<GraphNode> node {nullptr};
-        std::shared_ptr<GraphEdge> edge {nullptr};
+        std::uint32_t node {0};
+        std::uint32_t edge {kNoEdge};
 
         bool operator==(
             const PathStop& other
         ) const;
     };
 
-    // We need a custom PathStop hasher to use PathStop in std::unordered_map.
-    struct PathStopHash {
-        size_t operator()(
-            const PathStop& stop
+    // A path stop with its distance from the path starting point.
+    using PathStopDist = std::pair<PathStop, unsigned int>;
+
+    using Path = std::vector<PathStopDist>;
+
+    struct PathCmp {
+        bool operator()(
+            const Path& a,
+            const Path& b
         ) const;
     };
 
-    // We use PathStopDist in our path-finding algorithm to rank path stops
-    // by their distance from the path starting point.
-    using PathStopDist = std::pair<PathStop, unsigned int>;
+    // We use StateDist in our path-finding algorithm to rank the states of
+    // the route-expanded graph by their distance from the path starting point.
+    using StateDist = std::pair<std::uint32_t, unsigned int>;
 
-    // We need a custom PathStopDist comparator object to use PathStopDist in
-    // std::priority_queue.
-    struct PathStopDistCmp {
+    struct StateDistCmp {
         bool operator()(
-            const PathStopDist& a,
-            const PathStopDist& b
+            const StateDist& a,
+            const StateDist& b
         ) const;
     };
 
-    using Path = std::vector<PathStopDist>;
+    // A label of the quiet route search: One way to get to a state, with its
+    // travel time and crowding, and the label we extended to get there.
+    struct QuietLabel {
+        std::uint32_t state {0};
+        // kNoEdge for the labels we got to through a transfer arc.
+        std::uint32_t edge {kNoEdge};
+        unsigned int travelTime {0};
+        unsigned int crowding {0};
+        std::uint32_t previousLabel {kNoEdge};
+    };
 
-    struct PathCmp {
-        bool operator()(
-            const Path& a,
-            const Path& b
+    // We rank the quiet route labels by travel time, then crowding.
+    using QuietLabelRank = std::tuple<unsigned int, unsigned int, std::uint32_t>;
+
+    // Reusable scratch space for our path-finding algorithms.
+    // We address these flat arrays by state index (and by edge index for the
+    // excluded edges). Instead of clearing the arrays before each search, we
+    // bump a generation counter: A record is only valid if it was written in
+    // the current generation.
+    struct SearchWorkspace {
+        std::uint32_t generation {0};
+        std::vector<std::uint32_t> seen {};
+        std::vector<std::uint32_t> settled {};
+        std::vector<std::uint32_t> excluded {};
+        std::vector<unsigned int> distFromA {};
+        std::vector<std::uint32_t> previousState {};
+        std::vector<std::uint32_t> lastEdge {};
+        std::vector<StateDist> nodesToVisit {};
+
+        // Quiet route search labels, and the lowest crowding among the labels
+        // we settled at each state.
+        std::vector<QuietLabel> labels {};
+        std::vector<QuietLabelRank> labelsToVisit {};
+        std::vector<unsigned int> minCrowding {};
+
+        // Route changes of each state, the stations we reached, and the
+        // priority queue of states to visit by travel time and route changes,
+        // for the reachable stations search.
+        std::vector<unsigned int> nRouteChanges {};
+        std::vector<std::uint32_t> stationReached {};
+        std::vector<std::tuple<unsigned int, unsigned int, std::uint32_t>>
+            statesToReach {};
+
+        // Lagrangian cost of each state, and the priority queue of states to
+        // visit by cost and travel time.
+        std::vector<double> costFromA {};
+        std::vector<std::tuple<double, unsigned int, std::uint32_t>>
+            costsToVisit {};
+
+        // Travel time lower bounds to the destination, by station. We only
+        // calculate them for the stations we visit.
+        std::vector<std::uint32_t> lowerBoundSeen {};
+        std::vector<unsigned int> lowerBound {};
+
+        // Prepare the workspace for a new search over nStates states, nEdges
+        // edges and nStations stations.
+        void Reset(
+            const size_t nStates,
+            const size_t nEdges,
+            const size_t nStations
+        );
+    };
+
+    // Travel route cache key
+    // Fastest route queries only set the two stations.
+    struct RouteCacheKey {
+        bool quiet {false};
+        StationHandle stationA {kInvalidStationHandle};
+        StationHandle stationB {kInvalidStationHandle};
+        double maxSlowdownPc {0.0};
+        double minQuietnessPc {0.0};
+        size_t maxNPaths {0};
+        QuietRouteSearch search {QuietRouteSearch::kYen};
+        CrowdingModel model {CrowdingModel::kCumulative};
+
+        bool operator==(
+            const RouteCacheKey& other
+        ) const;
+    };
+
+    struct RouteCacheKeyHash {
+        size_t operator()(
+            const RouteCacheKey& key
         ) const;
     };
 
+    // Travel route cache entry
+    struct RouteCacheEntry {
+        TravelRoute travelRoute {};
+
+        // Graph version and crowding epoch at the time we found the route.
+        std::uint64_t graphVersion {0};
+        std::uint64_t crowdingEpoch {0};
+
+        // Candidate paths for a quiet route, and their crowding at the time we
+        // found the route. We only keep them for QuietRouteSearch::kYen with a
+        // crowding tolerance.
+        std::vector<Path> candidatePaths {};
+        std::vector<unsigned int> candidateCrowding {};
+    };
+
     // Map station and lines by ID. We do not map line routes here, as they
     // are mapped within each line representation.
     std::unordered_map<Id, std::shared_ptr<GraphNode>> stations_ {};
     std::unordered_map<Id, std::shared_ptr<LineInternal>> lines_ {};
 
+    // All stations and routes, in the order they were added to the network.
+    // Their position is also their index in the compact graph.
+    std::vector<std::shared_ptr<GraphNode>> stationNodes_ {};
+    std::vector<std::shared_ptr<LineInternal>> lineNodes_ {};
+    std::vector<std::shared_ptr<RouteInternal>> routeNodes_ {};
+
+    // The current graph. Graphs are immutable once published: Updates build
+    // a new graph and swap it in atomically, so that queries can load the
+    // current graph without locking and keep using it while the network
+    // changes.
+    std::shared_ptr<const Graph> graph_ {std::make_shared<const Graph>()};
+    std::uint64_t graphVersion_ {0};
+
+    // Settings for the next graph we build. Queries use the ones of their
+    // graph.
+    bool goalDirectedSearch_ {true};
+    bool precomputeFastestTravelRoutes_ {false};
+    bool precomputeContractionHierarchy_ {false};
+    unsigned int routeChangePenalty_ {kDefaultRouteChangePenalty};
+    double quietRouteCrowdingTolerancePc_ {0.0};
+
+    // Thread pool for the spur path searches of the quiet route search, if
+    // parallel.
+    std::shared_ptr<boost::asio::thread_pool> spurSearchPool_ {};
+
+    // Thread pool for the batch queries, if set.
+    std::shared_ptr<boost::asio::thread_pool> batchQueryPool_ {};
+
+    // Cache of the most recent travel route queries. Entries are shared so
+    // that a cache hit does not copy the candidate paths.
+    mutable LruCache<
+        RouteCacheKey,
+        std::shared_ptr<const RouteCacheEntry>,
+        RouteCacheKeyHash
+    > routeCache_ {};
+
     // Get station by ID.
     std::shared_ptr<GraphNode> GetStation(
         const Id& stationId
@@ -466,36 +1413,313 @@ private:
         const Id& routeId
     ) const;
 
-    // This function adds a route to the internal line representation.
+    // These functions add stations and lines to the network without
+    // rebuilding the compact graph. We use them to load many items at once.
+    bool AddStationToNetwork(
+        const Station& station
+    );
+    bool AddLineToNetwork(
+        const Line& line
+    );
+    bool SetTravelTimeInNetwork(
+        const Id& stationA,
+        const Id& stationB,
+        const unsigned int travelTime
+    );
+
+    // This function adds a route to the internal line representation. It
+    // does not change the rest of the network, so that we can drop the line
+    // if one of its routes is invalid.
     bool AddRouteToLine(
         const Route& route,
         const std::shared_ptr<LineInternal>& lineInternal
     );
 
+    // This function gives a route of a valid line its handle, and adds its
+    // edges to the stations it stops at.
+    void AddRouteToNetwork(
+        const std::shared_ptr<RouteInternal>& routeInternal
+    );
+
+    // SAX handler that streams a network layout JSON file into the network.
+    class LayoutSaxHandler;
+
+    // Rebuild the compact graph from the GraphNode/GraphEdge objects.
+    void BuildGraph();
+
+    // Fill the edges, interning tables, route stops and passenger counts of
+    // the compact graph from the GraphNode/GraphEdge objects.
+    void BuildGraphTables(
+        Graph& graph
+    ) const;
+
+    // Drop all stations, lines and routes.
+    void ClearNetwork();
+
+    // Build the route-expanded graph from the edges of the compact graph.
+    static void BuildStateGraph(
+        Graph& graph,
+        const unsigned int routeChangePenalty
+    );
+
+    // Select the landmark stations and calculate their distances to and from
+    // all other stations.
+    static void BuildLandmarks(
+        Graph& graph
+    );
+
+    // Fill the all-pairs fastest path tables of a graph.
+    void BuildFastestTravelRoutes(
+        const Graph& graph,
+        GraphIndexes& indexes
+    ) const;
+
+    // Get the indexes of a graph, and build the ones it asks for if they are
+    // missing. Queries do not wait: If another thread is building the
+    // indexes, or if a change already replaced the graph, we return the
+    // indexes as they are. With `wait`, we always build them.
+    const GraphIndexes& GetGraphIndexes(
+        const Graph& graph,
+        const bool wait = false
+    ) const;
+
+    // Build the Contraction Hierarchies index of a graph.
+    void BuildContractionHierarchy(
+        const Graph& graph,
+        GraphIndexes& indexes
+    ) const;
+
+    // Load the current graph.
+    std::shared_ptr<const Graph> LoadGraph() const;
+
+    // Make a graph the current one.
+    void PublishGraph(
+        Graph&& graph
+    );
+
+    // Get a lower bound for the travel time between two stations.
+    unsigned int GetTravelTimeLowerBound(
+        const Graph& graph,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB
+    ) const;
+
+    // Get the state of the route-expanded graph where a path stop leaves us.
+    // This is the state of the edge route at the stop station, or the
+    // departure state of the station for the path starting point.
+    std::uint32_t GetStopState(
+        const Graph& graph,
+        const PathStop& stop
+    ) const;
+
+    // Get the ride arc between two states, if any.
+    const Graph::StateArc* GetRideArc(
+        const Graph& graph,
+        const std::uint32_t state,
+        const std::uint32_t nextState
+    ) const;
+
+    // Check if a state is on the search tree path from the start state to
+    // another state.
+    bool IsSearchTreeAncestor(
+        const std::uint32_t ancestor,
+        const std::uint32_t state,
+        const std::uint32_t stateA,
+        const std::uint32_t* previousState
+    ) const;
+
+    // Assemble a path from a search tree, going backwards from the end state
+    // to the start state. The path only keeps the states we reached through
+    // ride arcs, as stops with their edges.
+    Path GetSearchTreePath(
+        const Graph& graph,
+        const PathStopDist& stopA,
+        const std::uint32_t stateA,
+        const std::uint32_t stateB,
+        const unsigned int* distFromA,
+        const std::uint32_t* previousState
+    ) const;
+
+    // Run nTasks tasks, task(0) to task(nTasks - 1), on a thread pool, and
+    // wait for all of them to finish. Without a pool, or from a thread of the
+    // pool, we run the tasks on the calling thread.
+    static void RunTasks(
+        boost::asio::thread_pool* pool,
+        const size_t nTasks,
+        const std::function<void(size_t)>& task
+    );
+
+    // Get the batch query thread pool of this network, or the pool all networks
+    // share when it has none.
+    boost::asio::thread_pool* GetBatchQueryPool() const;
+
+    // Run a batch of queries on the batch query thread pool.
+    void RunBatchQueries(
+        const size_t nQueries,
+        const std::function<void(size_t)>& query
+    ) const;
+
+    // Get the search workspace for the current thread.
+    // Searches on the same thread reuse the same workspace, so they do not
+    // allocate memory once the workspace has grown to the network size.
+    static SearchWorkspace& GetSearchWorkspace();
+
+    // Assemble a TravelRoute object from an internal path.
+    TravelRoute GetTravelRoute(
+        const Graph& graph,
+        const Path& path
+    ) const;
+
+    // Uncached version of the public GetFastestTravelRoute.
+    TravelRoute FindFastestTravelRoute(
+        const Graph& graph,
+        const StationHandle stationA,
+        const StationHandle stationB
+    ) const;
+
+    // Uncached version of the public GetQuietTravelRoute.
+    // If set, candidatePaths receives the paths we picked the route from.
+    TravelRoute FindQuietTravelRoute(
+        const Graph& graph,
+        const StationHandle stationA,
+        const StationHandle stationB,
+        const double maxSlowdownPc,
+        const double minQuietnessPc,
+        const size_t maxNPaths,
+        const QuietRouteSearch search,
+        const CrowdingModel model,
+        std::vector<Path>* candidatePaths = nullptr
+    ) const;
+
     // Internal version of GetFastestTravelRoute.
     // We pass station A as a PathStopDist instance instead of as a GraphNode
     // pointer to allow for warm starts, i.e. paths that start with a pre-set
     // distance-from-origin and incoming route.
     // We also pass a set of excluded stops in case we want to skip some
     // stations from the paht-finding algorithm.
+    // If station B is not a valid station, we search the whole network.
+    // We only look for paths that reach station B within maxTravelTime, and
+    // drop the states that cannot lead to one early.
     Path GetFastestTravelRoute(
+        const Graph& graph,
         const PathStopDist& stopA,
-        const std::shared_ptr<GraphNode>& stationB,
-        const std::unordered_set<PathStop, PathStopHash>& excludedStops = {}
+        const std::uint32_t stationB,
+        const std::vector<PathStop>& excludedStops = {},
+        const unsigned int maxTravelTime = kUnreachable
+    ) const;
+
+    // Get the fastest path between two stations, from the all-pairs tables
+    // or the Contraction Hierarchies index if we have them.
+    Path GetFastestPath(
+        const Graph& graph,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB
+    ) const;
+
+    // Get the fastest path between two stations from the Contraction
+    // Hierarchies index.
+    Path GetIndexedFastestPath(
+        const Graph& graph,
+        const GraphIndexes& indexes,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB
     ) const;
 
+    // Get a fingerprint of a path. Equal paths have the same fingerprint.
+    static std::uint64_t GetPathHash(
+        const Path& path
+    );
+
     // Internal function to get all the paths (up to maxNPaths) that meet a
     // certain travel time criterion:
     // bestTravelTime <= travelTime <= bestTravelTime * (1 + maxSlowdownPc)
-    std::vector<Path> GetFastestTravelRoutes(
-        const std::shared_ptr<TransportNetwork::GraphNode>& stationA,
-        const std::shared_ptr<TransportNetwork::GraphNode>& stationB,
+    // This is Yen's algorithm. The spur path searches of each iteration run
+    // on spurSearchPool_, if any.
+    std::vector<Path> GetKFastestPaths(
+        const Graph& graph,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB,
         const double maxSlowdownPc,
         const size_t maxNPaths = std::numeric_limits<size_t>::max()
     ) const;
 
+    // Get the travel times from a station to the target stations, and write
+    // them to a row of the travel time matrix.
+    // targetColumns lists the matrix columns of each station, by station.
+    void GetTravelTimesFrom(
+        const Graph& graph,
+        const std::uint32_t stationA,
+        const std::vector<std::vector<size_t>>& targetColumns,
+        const size_t nTargetStations,
+        unsigned int* row
+    ) const;
+
+    // Get the most quiet path between two stations that takes at most
+    // maxTravelTime, or an empty path if there is none. Among equally quiet
+    // paths, we pick the fastest one.
+    // This is a bi-criteria label-setting search, which keeps the labels
+    // that are Pareto-optimal in travel time and crowding at each state.
+    Path GetQuietestPath(
+        const Graph& graph,
+        const CrowdingModel model,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB,
+        const unsigned int maxTravelTime
+    ) const;
+
+    // Get the path between two stations with the lowest cost, where the cost
+    // of a path is its crowding plus lambda times its travel time. Among paths
+    // with the same cost, we pick the fastest one.
+    Path GetLagrangianPath(
+        const Graph& graph,
+        const CrowdingModel model,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB,
+        const double lambda
+    ) const;
+
+    // Get a quiet path between two stations that takes at most maxTravelTime,
+    // starting from the fastest path, or an empty path if there is none.
+    // We search the Lagrangian multiplier with the LARAC algorithm.
+    Path GetLagrangianQuietestPath(
+        const Graph& graph,
+        const CrowdingModel model,
+        const std::uint32_t stationA,
+        const std::uint32_t stationB,
+        const unsigned int maxTravelTime,
+        const Path& fastestPath
+    ) const;
+
+    // Get the route stop of a station and route, or kNoEdge if the route does
+    // not stop at the station.
+    static std::uint32_t GetRouteStop(
+        const Graph& graph,
+        const std::uint32_t station,
+        const std::uint32_t route
+    );
+
+    // Get the crowding of a stop, on a given route stop, or on no route if
+    // routeStop is kNoEdge. Stops with more passengers out than in count as
+    // empty.
+    unsigned int GetStopCrowding(
+        const Graph& graph,
+        const CrowdingModel model,
+        const std::uint32_t station,
+        const std::uint32_t routeStop
+    ) const;
+
+    // Get the crowding of a search state, when we ride to it or, for the route
+    // states we enter from a departure state, when we board its route.
+    unsigned int GetStateCrowding(
+        const Graph& graph,
+        const CrowdingModel model,
+        const std::uint32_t state
+    ) const;
+
     // Get the total crowding over a given path.
     unsigned int GetPathCrowding(
+        const Graph& graph,
+        const CrowdingModel model,
         const Path& path
     ) const;
 };
@@ -0,0 +1,462 @@
+#include <network-monitor/contraction-hierarchy.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+
+using NetworkMonitor::ContractionHierarchy;
+
+// Static functions
+
+// Maximum number of nodes a witness search settles before giving up. When we
+// give up, we add a shortcut that may not be needed, which is safe.
+static constexpr size_t kMaxWitnessSettledNodes {50};
+
+// A node with its distance from the search origin.
+using NodeDist = std::pair<unsigned int, std::uint32_t>;
+
+// Min-priority queue of nodes to visit.
+using NodeQueue = std::priority_queue<
+    NodeDist,
+    std::vector<NodeDist>,
+    std::greater<NodeDist>
+>;
+
+// Supporting data structures for the query searches. Entries are only valid
+// if their stamp matches the workspace generation, so we do not need to clear
+// them between queries.
+struct QueryWorkspace {
+    std::uint32_t generation {0};
+    std::vector<std::uint32_t> forwardSeen {};
+    std::vector<unsigned int> forwardDist {};
+    std::vector<std::uint32_t> forwardPrevious {};
+    std::vector<std::uint32_t> backwardSeen {};
+    std::vector<unsigned int> backwardDist {};
+    std::vector<std::uint32_t> backwardPrevious {};
+
+    void Reset(
+        const size_t nNodes
+    )
+    {
+        if (forwardSeen.size() < nNodes) {
+            forwardSeen.resize(nNodes, 0);
+            forwardDist.resize(nNodes, 0);
+            forwardPrevious.resize(nNodes, 0);
+            backwardSeen.resize(nNodes, 0);
+            backwardDist.resize(nNodes, 0);
+            backwardPrevious.resize(nNodes, 0);
+        }
+        ++generation;
+        if (generation == 0) {
+            std::fill(forwardSeen.begin(), forwardSeen.end(), 0);
+            std::fill(backwardSeen.begin(), backwardSeen.end(), 0);
+            generation = 1;
+        }
+    }
+};
+
+static QueryWorkspace& GetQueryWorkspace()
+{
+    thread_local QueryWorkspace workspace {};
+    return workspace;
+}
+
+// ContractionHierarchy — Public methods
+
+ContractionHierarchy::ContractionHierarchy() = default;
+
+ContractionHierarchy::ContractionHierarchy(
+    const size_t nNodes,
+    const std::vector<Arc>& arcs
+)
+{
+    // Working graph
+    // We never remove arcs from it. Instead, we skip the arcs to and from the
+    // nodes we already contracted.
+    struct WorkingArc {
+        std::uint32_t node {0};
+        unsigned int weight {0};
+        std::uint32_t middle {kNoNode};
+    };
+    std::vector<std::vector<WorkingArc>> outArcs(nNodes);
+    std::vector<std::vector<WorkingArc>> inArcs(nNodes);
+    auto addArc {[&outArcs, &inArcs](
+        const std::uint32_t from,
+        const std::uint32_t to,
+        const unsigned int weight,
+        const std::uint32_t middle
+    ) {
+        auto outArc {std::find_if(
+            outArcs[from].begin(),
+            outArcs[from].end(),
+            [to](const auto& arc) { return arc.node == to; }
+        )};
+        if (outArc == outArcs[from].end()) {
+            outArcs[from].push_back({to, weight, middle});
+            inArcs[to].push_back({from, weight, middle});
+            return;
+        }
+        if (weight < outArc->weight) {
+            auto inArc {std::find_if(
+                inArcs[to].begin(),
+                inArcs[to].end(),
+                [from](const auto& arc) { return arc.node == from; }
+            )};
+            *outArc = {to, weight, middle};
+            *inArc = {from, weight, middle};
+        }
+    }};
+    for (const auto& arc: arcs) {
+        if (arc.from >= nNodes || arc.to >= nNodes || arc.from == arc.to) {
+            continue;
+        }
+        addArc(arc.from, arc.to, arc.weight, kNoNode);
+    }
+
+    std::vector<bool> contracted(nNodes, false);
+    std::vector<unsigned int> nContractedNeighbors(nNodes, 0);
+
+    // Witness search
+    // We look for the shortest paths from a node that avoid the node we are
+    // contracting, up to a maximum distance.
+    std::vector<size_t> witnessSeen(nNodes, 0);
+    std::vector<unsigned int> witnessDist(nNodes, 0);
+    size_t witnessGeneration {0};
+    auto runWitnessSearch {[&](
+        const std::uint32_t source,
+        const std::uint32_t avoided,
+        const unsigned int maxDist
+    ) {
+        ++witnessGeneration;
+        NodeQueue nodesToVisit {};
+        witnessSeen[source] = witnessGeneration;
+        witnessDist[source] = 0;
+        nodesToVisit.push({0, source});
+        size_t nSettled {0};
+        while (!nodesToVisit.empty() && nSettled < kMaxWitnessSettledNodes) {
+            const auto [dist, node] = nodesToVisit.top();
+            nodesToVisit.pop();
+            if (dist > witnessDist[node]) {
+                continue;
+            }
+            if (dist > maxDist) {
+                break;
+            }
+            ++nSettled;
+            for (const auto& arc: outArcs[node]) {
+                if (arc.node == avoided || contracted[arc.node]) {
+                    continue;
+                }
+                const auto newDist {dist + arc.weight};
+                if (witnessSeen[arc.node] != witnessGeneration ||
+                    newDist < witnessDist[arc.node]) {
+                    witnessSeen[arc.node] = witnessGeneration;
+                    witnessDist[arc.node] = newDist;
+                    nodesToVisit.push({newDist, arc.node});
+                }
+            }
+        }
+    }};
+
+    // Find the shortcuts we need to contract a node: For each pair of
+    // neighbors u -> node -> x, we need a shortcut u -> x unless there is a
+    // path from u to x that avoids the node and is not longer.
+    std::vector<Arc> shortcuts {};
+    auto findShortcuts {[&](const std::uint32_t node) {
+        shortcuts.clear();
+        for (const auto& inArc: inArcs[node]) {
+            if (contracted[inArc.node]) {
+                continue;
+            }
+            unsigned int maxDist {0};
+            bool hasTargets {false};
+            for (const auto& outArc: outArcs[node]) {
+                if (contracted[outArc.node] || outArc.node == inArc.node) {
+                    continue;
+                }
+                maxDist = std::max(maxDist, inArc.weight + outArc.weight);
+                hasTargets = true;
+            }
+            if (!hasTargets) {
+                continue;
+            }
+            runWitnessSearch(inArc.node, node, maxDist);
+            for (const auto& outArc: outArcs[node]) {
+                if (contracted[outArc.node] || outArc.node == inArc.node) {
+                    continue;
+                }
+                const auto viaNode {inArc.weight + outArc.weight};
+                if (witnessSeen[outArc.node] != witnessGeneration ||
+                    witnessDist[outArc.node] > viaNode) {
+                    shortcuts.push_back({inArc.node, outArc.node, viaNode});
+                }
+            }
+        }
+    }};
+
+    // Contraction order
+    // We contract the least important nodes first: Those that add few
+    // shortcuts compared to the arcs they remove, and whose neighbors have
+    // not been contracted yet. We update the priorities lazily, when we pop
+    // a node from the queue.
+    auto getPriority {[&](const std::uint32_t node) {
+        findShortcuts(node);
+        int nArcs {0};
+        for (const auto& arc: inArcs[node]) {
+            nArcs += contracted[arc.node] ? 0 : 1;
+        }
+        for (const auto& arc: outArcs[node]) {
+            nArcs += contracted[arc.node] ? 0 : 1;
+        }
+        return static_cast<int>(shortcuts.size()) - nArcs +
+               static_cast<int>(nContractedNeighbors[node]);
+    }};
+    using NodePriority = std::pair<int, std::uint32_t>;
+    std::priority_queue<
+        NodePriority,
+        std::vector<NodePriority>,
+        std::greater<NodePriority>
+    > nodesToContract {};
+    for (std::uint32_t node {0}; node < nNodes; ++node) {
+        nodesToContract.push({getPriority(node), node});
+    }
+
+    // Contraction
+    // When we contract a node, all its remaining neighbors rank higher than
+    // it, so its remaining arcs become part of the upward graphs.
+    std::vector<std::vector<UpwardArc>> forwardArcs(nNodes);
+    std::vector<std::vector<UpwardArc>> backwardArcs(nNodes);
+    while (!nodesToContract.empty()) {
+        const auto node {nodesToContract.top().second};
+        nodesToContract.pop();
+        if (contracted[node]) {
+            continue;
+        }
+        const auto priority {getPriority(node)};
+        if (!nodesToContract.empty() &&
+            priority > nodesToContract.top().first) {
+            nodesToContract.push({priority, node});
+            continue;
+        }
+
+        // Note: getPriority left the shortcuts for this node in `shortcuts`.
+        for (const auto& arc: outArcs[node]) {
+            if (!contracted[arc.node]) {
+                forwardArcs[node].push_back({arc.node, arc.weight, arc.middle});
+                ++nContractedNeighbors[arc.node];
+            }
+        }
+        for (const auto& arc: inArcs[node]) {
+            if (!contracted[arc.node]) {
+                backwardArcs[node].push_back({arc.node, arc.weight, arc.middle});
+                ++nContractedNeighbors[arc.node];
+            }
+        }
+        for (const auto& shortcut: shortcuts) {
+            addArc(shortcut.from, shortcut.to, shortcut.weight, node);
+        }
+        nShortcuts_ += shortcuts.size();
+        contracted[node] = true;
+    }
+
+    // Compact the upward graphs.
+    auto compact {[nNodes](
+        const std::vector<std::vector<UpwardArc>>& arcsByNode,
+        std::vector<std::uint32_t>& offsets,
+        std::vector<UpwardArc>& arcs
+    ) {
+        offsets.reserve(nNodes + 1);
+        offsets.push_back(0);
+        for (const auto& nodeArcs: arcsByNode) {
+            arcs.insert(arcs.end(), nodeArcs.begin(), nodeArcs.end());
+            offsets.push_back(static_cast<std::uint32_t>(arcs.size()));
+        }
+    }};
+    compact(forwardArcs, forwardOffsets_, forwardArcs_);
+    compact(backwardArcs, backwardOffsets_, backwardArcs_);
+}
+
+bool ContractionHierarchy::IsEmpty() const
+{
+    return GetNNodes() == 0;
+}
+
+size_t ContractionHierarchy::GetNNodes() const
+{
+    return forwardOffsets_.empty() ? 0 : forwardOffsets_.size() - 1;
+}
+
+size_t ContractionHierarchy::GetNShortcuts() const
+{
+    return nShortcuts_;
+}
+
+size_t ContractionHierarchy::GetMemoryUsage() const
+{
+    return sizeof(*this) +
+           forwardOffsets_.capacity() * sizeof(std::uint32_t) +
+           forwardArcs_.capacity() * sizeof(UpwardArc) +
+           backwardOffsets_.capacity() * sizeof(std::uint32_t) +
+           backwardArcs_.capacity() * sizeof(UpwardArc);
+}
+
+unsigned int ContractionHierarchy::GetShortestPath(
+    const std::uint32_t source,
+    const std::uint32_t target,
+    std::vector<std::uint32_t>& path
+) const
+{
+    path.clear();
+    const auto nNodes {GetNNodes()};
+    if (source >= nNodes || target >= nNodes) {
+        return kUnreachable;
+    }
+    if (source == target) {
+        path.push_back(source);
+        return 0;
+    }
+
+    auto& workspace {GetQueryWorkspace()};
+    workspace.Reset(nNodes);
+    const auto generation {workspace.generation};
+
+    // Upward search from one end of the path.
+    // We stop once all nodes left in the queue are farther than the best path
+    // we know of.
+    auto runSearch {[generation](
+        const std::uint32_t origin,
+        const std::vector<std::uint32_t>& offsets,
+        const std::vector<UpwardArc>& arcs,
+        std::vector<std::uint32_t>& seen,
+        std::vector<unsigned int>& dist,
+        std::vector<std::uint32_t>& previous,
+        const auto& onSettled,
+        const unsigned int& bestDist
+    ) {
+        NodeQueue nodesToVisit {};
+        seen[origin] = generation;
+        dist[origin] = 0;
+        nodesToVisit.push({0, origin});
+        while (!nodesToVisit.empty()) {
+            const auto [nodeDist, node] = nodesToVisit.top();
+            nodesToVisit.pop();
+            if (nodeDist > dist[node]) {
+                continue;
+            }
+            if (nodeDist >= bestDist) {
+                break;
+            }
+            onSettled(node, nodeDist);
+            for (auto idx {offsets[node]}; idx < offsets[node + 1]; ++idx) {
+                const auto& arc {arcs[idx]};
+                const auto newDist {nodeDist + arc.weight};
+                if (seen[arc.node] != generation || newDist < dist[arc.node]) {
+                    seen[arc.node] = generation;
+                    dist[arc.node] = newDist;
+                    previous[arc.node] = node;
+                    nodesToVisit.push({newDist, arc.node});
+                }
+            }
+        }
+    }};
+
+    // The forward search explores the whole upward search space of the
+    // source, which is small. The backward search then looks for the node
+    // where the two searches meet with the shortest total distance.
+    unsigned int bestDist {kUnreachable};
+    std::uint32_t meetingNode {kNoNode};
+    runSearch(
+        source,
+        forwardOffsets_,
+        forwardArcs_,
+        workspace.forwardSeen,
+        workspace.forwardDist,
+        workspace.forwardPrevious,
+        [](std::uint32_t, unsigned int) {},
+        bestDist
+    );
+    runSearch(
+        target,
+        backwardOffsets_,
+        backwardArcs_,
+        workspace.backwardSeen,
+        workspace.backwardDist,
+        workspace.backwardPrevious,
+        [&workspace, &bestDist, &meetingNode, generation](
+            const std::uint32_t node,
+            const unsigned int nodeDist
+        ) {
+            if (workspace.forwardSeen[node] == generation &&
+                workspace.forwardDist[node] + nodeDist < bestDist) {
+                bestDist = workspace.forwardDist[node] + nodeDist;
+                meetingNode = node;
+            }
+        },
+        bestDist
+    );
+    if (meetingNode == kNoNode) {
+        return kUnreachable;
+    }
+
+    // Assemble the upward path from the source to the meeting node, and then
+    // the downward path to the target, unpacking the shortcuts on the way.
+    std::vector<std::uint32_t> upwardNodes {meetingNode};
+    while (upwardNodes.back() != source) {
+        upwardNodes.push_back(workspace.forwardPrevious[upwardNodes.back()]);
+    }
+    std::reverse(upwardNodes.begin(), upwardNodes.end());
+    path.push_back(source);
+    for (size_t idx {1}; idx < upwardNodes.size(); ++idx) {
+        const auto& from {upwardNodes[idx - 1]};
+        const auto& to {upwardNodes[idx]};
+        UnpackArc(from, to, FindArc(from, to, true)->middle, path);
+    }
+    auto node {meetingNode};
+    while (node != target) {
+        const auto next {workspace.backwardPrevious[node]};
+        UnpackArc(node, next, FindArc(next, node, false)->middle, path);
+        node = next;
+    }
+
+    return bestDist;
+}
+
+// ContractionHierarchy — Private methods
+
+const ContractionHierarchy::UpwardArc* ContractionHierarchy::FindArc(
+    const std::uint32_t lower,
+    const std::uint32_t upper,
+    const bool forward
+) const
+{
+    const auto& offsets {forward ? forwardOffsets_ : backwardOffsets_};
+    const auto& arcs {forward ? forwardArcs_ : backwardArcs_};
+    for (auto idx {offsets[lower]}; idx < offsets[lower + 1]; ++idx) {
+        if (arcs[idx].node == upper) {
+            return &arcs[idx];
+        }
+    }
+    return nullptr;
+}
+
+void ContractionHierarchy::UnpackArc(
+    const std::uint32_t from,
+    const std::uint32_t to,
+    const std::uint32_t middle,
+    std::vector<std::uint32_t>& path
+) const
+{
+    if (middle == kNoNode) {
+        path.push_back(to);
+        return;
+    }
+
+    // The shortcut skips the middle node, which was contracted before both
+    // ends. Its two halves are upward arcs of the middle node.
+    UnpackArc(from, middle, FindArc(middle, from, false)->middle, path);
+    UnpackArc(middle, to, FindArc(middle, to, true)->middle, path);
+}
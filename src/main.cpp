@@ -30,6 +30,7 @@ int main()
         0.1,
         0.1,
         20,
+        GetEnvVar("LTNM_NETWORK_SNAPSHOT_FILE_PATH", ""),
     };
 
     // Optional run timeout
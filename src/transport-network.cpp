@@ -1,26 +1,53 @@
 #include <network-monitor/transport-network.h>
 
-#include <nlohmann/json.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
-#include <boost/container_hash/hash.hpp>
+#include <nlohmann/json.hpp>
 
 #include <spdlog/spdlog.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <system_error>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+using NetworkMonitor::ContractionHierarchy;
+using NetworkMonitor::CrowdingModel;
 using NetworkMonitor::Id;
 using NetworkMonitor::Line;
 using NetworkMonitor::PassengerEvent;
+using NetworkMonitor::QuietRouteSearch;
+using NetworkMonitor::ReachableStation;
 using NetworkMonitor::Route;
+using NetworkMonitor::RouteHandle;
 using NetworkMonitor::Station;
+using NetworkMonitor::StationHandle;
 using NetworkMonitor::TransportNetwork;
 using NetworkMonitor::TravelRoute;
+using NetworkMonitor::kUnreachableTravelTime;
 
 // Station — Public methods
 
@@ -62,6 +89,15 @@ bool TravelRoute::operator==(const TravelRoute& other) const
         steps == other.steps;
 }
 
+// ReachableStation — Public methods
+
+bool ReachableStation::operator==(const ReachableStation& other) const
+{
+    return stationId == other.stationId &&
+        travelTime == other.travelTime &&
+        nRouteChanges == other.nRouteChanges;
+}
+
 // Free functions
 
 void NetworkMonitor::from_json(
@@ -70,6 +106,10 @@ void NetworkMonitor::from_json(
 )
 {
     dst.stationId = src.at("station_id").get<std::string>();
+    const auto routeIdIt {src.find("route_id")};
+    if (routeIdIt != src.end()) {
+        dst.routeId = routeIdIt->get<std::string>();
+    }
     dst.type = src.at("passenger_event").get<std::string>() == "in" ?
         PassengerEvent::Type::In : PassengerEvent::Type::Out;
 
@@ -134,6 +174,771 @@ void NetworkMonitor::from_json(
     dst.steps = src.at("steps").get<std::vector<TravelRoute::Step>>();
 }
 
+// Static functions
+
+// Station adjacency lists, as (next station, travel time) pairs.
+using StationAdjacency = std::vector<
+    std::vector<std::pair<std::uint32_t, unsigned int>>
+>;
+
+// Get the travel time from a station to all other stations, with Dijkstra's
+// algorithm. Unreachable stations get the maximum travel time.
+static std::vector<unsigned int> GetStationDistances(
+    const StationAdjacency& adjacency,
+    const std::uint32_t source
+)
+{
+    using StationDist = std::pair<unsigned int, std::uint32_t>;
+    std::vector<unsigned int> dist(
+        adjacency.size(),
+        std::numeric_limits<unsigned int>::max()
+    );
+    std::priority_queue<
+        StationDist,
+        std::vector<StationDist>,
+        std::greater<StationDist>
+    > stationsToVisit {};
+    dist[source] = 0;
+    stationsToVisit.push({0, source});
+    while (!stationsToVisit.empty()) {
+        const auto [stationDist, station] = stationsToVisit.top();
+        stationsToVisit.pop();
+        if (stationDist > dist[station]) {
+            continue;
+        }
+        for (const auto& [neighbor, travelTime]: adjacency[station]) {
+            if (stationDist + travelTime < dist[neighbor]) {
+                dist[neighbor] = stationDist + travelTime;
+                stationsToVisit.push({dist[neighbor], neighbor});
+            }
+        }
+    }
+    return dist;
+}
+
+// Get the thread pool for the batch queries of the networks with no pool of
+// their own. We create it on first use, so that it costs nothing to the
+// programs that never run a batch query.
+static boost::asio::thread_pool& GetDefaultBatchQueryPool()
+{
+    static boost::asio::thread_pool pool {
+        std::max(1u, std::thread::hardware_concurrency())
+    };
+    return pool;
+}
+
+// Pack a decayed count with the time of its last update.
+static std::uint64_t PackDecayedCount(
+    const double value,
+    const std::uint32_t time
+)
+{
+    const auto floatValue {static_cast<float>(value)};
+    std::uint32_t valueBits {0};
+    std::memcpy(&valueBits, &floatValue, sizeof(valueBits));
+    return (static_cast<std::uint64_t>(valueBits) << 32) | time;
+}
+
+// Unpack a decayed count and the time of its last update.
+static std::pair<double, std::uint32_t> UnpackDecayedCount(
+    const std::uint64_t packed
+)
+{
+    const auto valueBits {static_cast<std::uint32_t>(packed >> 32)};
+    float value {0.0f};
+    std::memcpy(&value, &valueBits, sizeof(value));
+    return {value, static_cast<std::uint32_t>(packed)};
+}
+
+// Binary snapshot layout
+// A snapshot starts with a header and a table of sections, one entry for each
+// SnapshotSection. Each section is an array of fixed-size items, at an 8-byte
+// aligned offset from the start of the file. We store all values in the byte
+// order of the machine that wrote the snapshot, and all references between
+// items as array indices, so that the snapshot does not depend on where we
+// map it.
+static constexpr char kSnapshotMagic[8] {'N', 'M', 'S', 'N', 'A', 'P', 0, 0};
+
+// Increment this every time the snapshot layout changes.
+static constexpr std::uint32_t kSnapshotLayoutVersion {1};
+
+// A snapshot from a machine with a different byte order reads this value
+// byte-swapped.
+static constexpr std::uint32_t kSnapshotByteOrderMark {0x01020304};
+
+struct SnapshotHeader {
+    char magic[8] {};
+    std::uint32_t layoutVersion {0};
+    std::uint32_t byteOrderMark {0};
+    std::uint64_t fileSize {0};
+
+    // FNV-1a hash of the file after the header.
+    std::uint64_t checksum {0};
+
+    // The route-expanded graph depends on the route change penalty.
+    std::uint32_t routeChangePenalty {0};
+    std::uint32_t nRouteStates {0};
+};
+
+enum class SnapshotSection : std::uint32_t {
+    // String table: The characters of string idx are
+    // stringChars[stringOffsets[idx], stringOffsets[idx + 1]).
+    kStringOffsets,
+    kStringChars,
+    kStations,
+    kLines,
+    kRoutes,
+    // Same as the compact graph arrays of the same name.
+    kRouteStopOffsets,
+    kRouteStops,
+    kEdgeOffsets,
+    kEdges,
+    kStateStations,
+    kEdgeStates,
+    kStateArcOffsets,
+    kStateArcs,
+    kStateRouteStops,
+    kLandmarks,
+    kLandmarkDistFrom,
+    kLandmarkDistTo,
+    kCount,
+};
+
+struct SnapshotSectionEntry {
+    std::uint64_t offset {0};
+    std::uint64_t size {0};
+};
+
+// Stations and lines refer to their ID and name in the string table.
+struct SnapshotStation {
+    std::uint32_t id {0};
+    std::uint32_t name {0};
+};
+using SnapshotLine = SnapshotStation;
+
+struct SnapshotRoute {
+    std::uint32_t id {0};
+    std::uint32_t line {0};
+};
+
+static constexpr size_t kSnapshotSectionsOffset {sizeof(SnapshotHeader)};
+static constexpr size_t kSnapshotSectionsEnd {
+    kSnapshotSectionsOffset +
+    static_cast<size_t>(SnapshotSection::kCount) * sizeof(SnapshotSectionEntry)
+};
+
+// Get the FNV-1a hash of a byte array.
+static std::uint64_t GetSnapshotChecksum(
+    const char* data,
+    const size_t size
+)
+{
+    std::uint64_t hash {0xcbf29ce484222325};
+    for (size_t idx {0}; idx < size; ++idx) {
+        hash ^= static_cast<unsigned char>(data[idx]);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+// Append a section to a snapshot under construction.
+template <typename T>
+static void AppendSnapshotSection(
+    std::vector<char>& data,
+    const SnapshotSection section,
+    const std::vector<T>& items
+)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    data.resize((data.size() + 7) / 8 * 8, 0);
+    const SnapshotSectionEntry entry {data.size(), items.size() * sizeof(T)};
+    std::memcpy(
+        data.data() + kSnapshotSectionsOffset +
+            static_cast<size_t>(section) * sizeof(SnapshotSectionEntry),
+        &entry,
+        sizeof(entry)
+    );
+    const auto* begin {reinterpret_cast<const char*>(items.data())};
+    data.insert(data.end(), begin, begin + entry.size);
+}
+
+// Copy a section out of a snapshot.
+// Returns false if the section does not fit in the snapshot.
+template <typename T>
+static bool ReadSnapshotSection(
+    const char* data,
+    const size_t size,
+    const SnapshotSection section,
+    std::vector<T>& items
+)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    SnapshotSectionEntry entry {};
+    std::memcpy(
+        &entry,
+        data + kSnapshotSectionsOffset +
+            static_cast<size_t>(section) * sizeof(SnapshotSectionEntry),
+        sizeof(entry)
+    );
+    if (entry.offset < kSnapshotSectionsEnd || entry.offset > size ||
+        entry.size > size - entry.offset || entry.size % sizeof(T) != 0) {
+        return false;
+    }
+    items.resize(entry.size / sizeof(T));
+    std::memcpy(items.data(), data + entry.offset, entry.size);
+    return true;
+}
+
+// Check that all values in an array are lower than a bound.
+template <typename T>
+static bool AreSnapshotIndices(
+    const std::vector<T>& values,
+    const size_t bound
+)
+{
+    return std::all_of(values.begin(), values.end(), [bound](const T value) {
+        return value < bound;
+    });
+}
+
+// Check that an array has the offsets of nItems consecutive ranges, which
+// cover an array of the given size.
+static bool AreSnapshotOffsets(
+    const std::vector<std::uint32_t>& offsets,
+    const size_t nItems,
+    const size_t size
+)
+{
+    return offsets.size() == nItems + 1 && offsets.front() == 0 &&
+        offsets.back() == size &&
+        std::is_sorted(offsets.begin(), offsets.end());
+}
+
+// Both network layout loaders only accept travel times that fit in an
+// unsigned int.
+static constexpr char kBadTravelTimeError[] {
+    "Travel times in the network layout must be unsigned integers"
+};
+
+// TransportNetwork::LayoutSaxHandler
+
+// We stream a network layout JSON file through this handler with
+// nlohmann::json::sax_parse, so that we never hold the whole file in memory.
+// The handler keeps one frame for each open object or array. We fill the
+// fields of the current station, line, route or travel time in place, and we
+// skip all the values we do not need.
+class TransportNetwork::LayoutSaxHandler: public nlohmann::json::json_sax_t {
+public:
+    explicit LayoutSaxHandler(
+        TransportNetwork& network
+    );
+
+    // Check that the layout had stations, lines and travel times.
+    // Returns false if we could not set some travel times.
+    bool Finish() const;
+
+    bool null() override;
+    bool boolean(
+        bool value
+    ) override;
+    bool number_integer(
+        number_integer_t value
+    ) override;
+    bool number_unsigned(
+        number_unsigned_t value
+    ) override;
+    bool number_float(
+        number_float_t value,
+        const string_t& text
+    ) override;
+    bool string(
+        string_t& value
+    ) override;
+    bool binary(
+        binary_t& value
+    ) override;
+    bool start_object(
+        std::size_t nElements
+    ) override;
+    bool key(
+        string_t& value
+    ) override;
+    bool end_object() override;
+    bool start_array(
+        std::size_t nElements
+    ) override;
+    bool end_array() override;
+    bool parse_error(
+        std::size_t position,
+        const std::string& lastToken,
+        const nlohmann::json::exception& ex
+    ) override;
+
+private:
+    // The JSON value we are in.
+    enum class Context {
+        kDocument,
+        kLayout,
+        kStations,
+        kStation,
+        kLines,
+        kLine,
+        kRoutes,
+        kRoute,
+        kRouteStops,
+        kTravelTimes,
+        kTravelTime,
+        kSkip,
+    };
+
+    // An open object or array.
+    // For the items we parse, `fields` has a bit for each required field we
+    // found.
+    struct Frame {
+        Context context {Context::kSkip};
+        unsigned int fields {0};
+    };
+
+    struct TravelTime {
+        Id stationA {};
+        Id stationB {};
+        unsigned int travelTime {0};
+    };
+
+    // The bits of the required fields that are not strings. GetStringField
+    // has the others.
+    static constexpr unsigned int kLineRoutesBit {1 << 2};
+    static constexpr unsigned int kRouteStopsBit {1 << 5};
+    static constexpr unsigned int kTravelTimeBit {1 << 2};
+
+    // All the required fields of each item.
+    static constexpr unsigned int kStationFields {(1 << 2) - 1};
+    static constexpr unsigned int kLineFields {(1 << 3) - 1};
+    static constexpr unsigned int kRouteFields {(1 << 6) - 1};
+    static constexpr unsigned int kTravelTimeFields {(1 << 3) - 1};
+
+    TransportNetwork& network_;
+    std::vector<Frame> frames_ {{Context::kDocument, 0}};
+    std::string key_ {};
+    Station station_ {};
+    Line line_ {};
+    Route route_ {};
+    TravelTime travelTime_ {};
+
+    // Lines need their stations, and travel times need their routes. We hold
+    // on to the items that come before the items they depend on.
+    std::vector<Line> pendingLines_ {};
+    std::vector<TravelTime> pendingTravelTimes_ {};
+    bool stationsDone_ {false};
+    bool linesDone_ {false};
+    bool travelTimesDone_ {false};
+    bool ok_ {true};
+
+    // Get the string field of the current item for the current key, and its
+    // bit. Returns a nullptr field for the fields we do not need.
+    std::pair<std::string*, unsigned int> GetStringField(
+        const Context context
+    );
+
+    // Throw if the current array cannot hold a value.
+    // Our arrays hold objects, except for the route stops, which are strings.
+    void CheckArrayValue(
+        const bool isObject,
+        const bool isString
+    ) const;
+
+    // Check if the current value is the travel time of a travel time item.
+    bool IsTravelTimeValue() const;
+
+    void AddLine(
+        Line&& line
+    );
+
+    void SetTravelTime(
+        TravelTime&& travelTime
+    );
+
+    // Add the items we held on to, if the items they depend on are in.
+    void AddPendingItems();
+};
+
+TransportNetwork::LayoutSaxHandler::LayoutSaxHandler(
+    TransportNetwork& network
+) : network_ {network}
+{
+}
+
+bool TransportNetwork::LayoutSaxHandler::Finish() const
+{
+    if (!stationsDone_ || !linesDone_ || !travelTimesDone_) {
+        throw std::runtime_error(
+            "The network layout needs stations, lines and travel times"
+        );
+    }
+    return ok_;
+}
+
+bool TransportNetwork::LayoutSaxHandler::null()
+{
+    CheckArrayValue(false, false);
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::boolean(
+    [[maybe_unused]] bool value
+)
+{
+    CheckArrayValue(false, false);
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::number_integer(
+    [[maybe_unused]] number_integer_t value
+)
+{
+    // The parser only gives us the negative numbers here, and travel times
+    // cannot be negative.
+    CheckArrayValue(false, false);
+    if (IsTravelTimeValue()) {
+        throw std::runtime_error(kBadTravelTimeError);
+    }
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::number_unsigned(
+    number_unsigned_t value
+)
+{
+    CheckArrayValue(false, false);
+    if (IsTravelTimeValue()) {
+        if (value > std::numeric_limits<unsigned int>::max()) {
+            throw std::runtime_error(kBadTravelTimeError);
+        }
+        travelTime_.travelTime = static_cast<unsigned int>(value);
+        frames_.back().fields |= kTravelTimeBit;
+    }
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::number_float(
+    [[maybe_unused]] number_float_t value,
+    [[maybe_unused]] const string_t& text
+)
+{
+    CheckArrayValue(false, false);
+    if (IsTravelTimeValue()) {
+        throw std::runtime_error(kBadTravelTimeError);
+    }
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::string(
+    string_t& value
+)
+{
+    CheckArrayValue(false, true);
+    auto& frame {frames_.back()};
+    if (frame.context == Context::kRouteStops) {
+        route_.stops.push_back(std::move(value));
+        return true;
+    }
+    const auto [field, bit] = GetStringField(frame.context);
+    if (field != nullptr) {
+        *field = std::move(value);
+        frame.fields |= bit;
+    }
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::binary(
+    [[maybe_unused]] binary_t& value
+)
+{
+    CheckArrayValue(false, false);
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::start_object(
+    [[maybe_unused]] std::size_t nElements
+)
+{
+    CheckArrayValue(true, false);
+    Context context {Context::kSkip};
+    switch (frames_.back().context) {
+    case Context::kDocument:
+        context = Context::kLayout;
+        break;
+    case Context::kStations:
+        context = Context::kStation;
+        station_ = {};
+        break;
+    case Context::kLines:
+        context = Context::kLine;
+        line_ = {};
+        break;
+    case Context::kRoutes:
+        context = Context::kRoute;
+        route_ = {};
+        break;
+    case Context::kTravelTimes:
+        context = Context::kTravelTime;
+        travelTime_ = {};
+        break;
+    default:
+        break;
+    }
+    frames_.push_back({context, 0});
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::key(
+    string_t& value
+)
+{
+    key_ = std::move(value);
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::end_object()
+{
+    const auto frame {frames_.back()};
+    frames_.pop_back();
+    switch (frame.context) {
+    case Context::kStation:
+        if (frame.fields != kStationFields) {
+            throw std::runtime_error(
+                "Incomplete station in the network layout"
+            );
+        }
+        if (!network_.AddStationToNetwork(station_)) {
+            throw std::runtime_error("Could not add station " + station_.id);
+        }
+        break;
+    case Context::kLine:
+        if (frame.fields != kLineFields) {
+            throw std::runtime_error("Incomplete line in the network layout");
+        }
+        AddLine(std::move(line_));
+        break;
+    case Context::kRoute:
+        if (frame.fields != kRouteFields) {
+            throw std::runtime_error("Incomplete route in the network layout");
+        }
+        line_.routes.push_back(std::move(route_));
+        break;
+    case Context::kTravelTime:
+        if (frame.fields != kTravelTimeFields) {
+            throw std::runtime_error(
+                "Incomplete travel time in the network layout"
+            );
+        }
+        SetTravelTime(std::move(travelTime_));
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::start_array(
+    [[maybe_unused]] std::size_t nElements
+)
+{
+    CheckArrayValue(false, false);
+    auto& frame {frames_.back()};
+    Context context {Context::kSkip};
+    if (frame.context == Context::kLayout) {
+        if (key_ == "stations") {
+            context = Context::kStations;
+        } else if (key_ == "lines") {
+            context = Context::kLines;
+        } else if (key_ == "travel_times") {
+            context = Context::kTravelTimes;
+        }
+    } else if (frame.context == Context::kLine && key_ == "routes") {
+        context = Context::kRoutes;
+        frame.fields |= kLineRoutesBit;
+    } else if (frame.context == Context::kRoute && key_ == "route_stops") {
+        context = Context::kRouteStops;
+        frame.fields |= kRouteStopsBit;
+        route_.stops.clear();
+    }
+    frames_.push_back({context, 0});
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::end_array()
+{
+    const auto context {frames_.back().context};
+    frames_.pop_back();
+    switch (context) {
+    case Context::kStations:
+        stationsDone_ = true;
+        break;
+    case Context::kLines:
+        linesDone_ = true;
+        break;
+    case Context::kTravelTimes:
+        travelTimesDone_ = true;
+        break;
+    default:
+        return true;
+    }
+    AddPendingItems();
+    return true;
+}
+
+bool TransportNetwork::LayoutSaxHandler::parse_error(
+    [[maybe_unused]] std::size_t position,
+    [[maybe_unused]] const std::string& lastToken,
+    const nlohmann::json::exception& ex
+)
+{
+    // The parser only reports syntax errors and numbers out of range. We throw
+    // them with their own type, as nlohmann::json::parse does.
+    using nlohmann::json;
+    if (const auto* error {dynamic_cast<const json::parse_error*>(&ex)}) {
+        throw *error;
+    }
+    if (const auto* error {dynamic_cast<const json::out_of_range*>(&ex)}) {
+        throw *error;
+    }
+    throw std::runtime_error(ex.what());
+}
+
+std::pair<std::string*, unsigned int>
+TransportNetwork::LayoutSaxHandler::GetStringField(
+    const Context context
+)
+{
+    switch (context) {
+    case Context::kStation:
+        if (key_ == "station_id") {
+            return {&station_.id, 1 << 0};
+        }
+        if (key_ == "name") {
+            return {&station_.name, 1 << 1};
+        }
+        break;
+    case Context::kLine:
+        if (key_ == "line_id") {
+            return {&line_.id, 1 << 0};
+        }
+        if (key_ == "name") {
+            return {&line_.name, 1 << 1};
+        }
+        break;
+    case Context::kRoute:
+        if (key_ == "route_id") {
+            return {&route_.id, 1 << 0};
+        }
+        if (key_ == "direction") {
+            return {&route_.direction, 1 << 1};
+        }
+        if (key_ == "line_id") {
+            return {&route_.lineId, 1 << 2};
+        }
+        if (key_ == "start_station_id") {
+            return {&route_.startStationId, 1 << 3};
+        }
+        if (key_ == "end_station_id") {
+            return {&route_.endStationId, 1 << 4};
+        }
+        break;
+    case Context::kTravelTime:
+        if (key_ == "start_station_id") {
+            return {&travelTime_.stationA, 1 << 0};
+        }
+        if (key_ == "end_station_id") {
+            return {&travelTime_.stationB, 1 << 1};
+        }
+        break;
+    default:
+        break;
+    }
+    return {nullptr, 0};
+}
+
+void TransportNetwork::LayoutSaxHandler::CheckArrayValue(
+    const bool isObject,
+    const bool isString
+) const
+{
+    switch (frames_.back().context) {
+    case Context::kStations:
+    case Context::kLines:
+    case Context::kRoutes:
+    case Context::kTravelTimes:
+        if (!isObject) {
+            throw std::runtime_error(
+                "Expected an object in the network layout"
+            );
+        }
+        break;
+    case Context::kRouteStops:
+        if (!isString) {
+            throw std::runtime_error(
+                "Expected a station ID in the network layout"
+            );
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+bool TransportNetwork::LayoutSaxHandler::IsTravelTimeValue() const
+{
+    return frames_.back().context == Context::kTravelTime &&
+        key_ == "travel_time";
+}
+
+void TransportNetwork::LayoutSaxHandler::AddLine(
+    Line&& line
+)
+{
+    if (!stationsDone_) {
+        pendingLines_.push_back(std::move(line));
+        return;
+    }
+    if (!network_.AddLineToNetwork(line)) {
+        throw std::runtime_error("Could not add line " + line.id);
+    }
+}
+
+void TransportNetwork::LayoutSaxHandler::SetTravelTime(
+    TravelTime&& travelTime
+)
+{
+    if (!stationsDone_ || !linesDone_) {
+        pendingTravelTimes_.push_back(std::move(travelTime));
+        return;
+    }
+    ok_ &= network_.SetTravelTimeInNetwork(
+        travelTime.stationA,
+        travelTime.stationB,
+        travelTime.travelTime
+    );
+}
+
+void TransportNetwork::LayoutSaxHandler::AddPendingItems()
+{
+    if (stationsDone_ && !pendingLines_.empty()) {
+        auto lines {std::move(pendingLines_)};
+        pendingLines_ = {};
+        for (auto& line: lines) {
+            AddLine(std::move(line));
+        }
+    }
+    if (stationsDone_ && linesDone_ && !pendingTravelTimes_.empty()) {
+        auto travelTimes {std::move(pendingTravelTimes_)};
+        pendingTravelTimes_ = {};
+        for (auto& travelTime: travelTimes) {
+            SetTravelTime(std::move(travelTime));
+        }
+    }
+}
+
 // TransportNetwork — Public methods
 
 TransportNetwork::TransportNetwork() = default;
@@ -168,7 +973,7 @@ bool TransportNetwork::FromJson(
             std::move(stationJson.at("station_id").get<std::string>()),
             std::move(stationJson.at("name").get<std::string>()),
         };
-        ok &= AddStation(station);
+        ok &= AddStationToNetwork(station);
         if (!ok) {
             throw std::runtime_error("Could not add station " + station.id);
         }
@@ -194,7 +999,7 @@ bool TransportNetwork::FromJson(
                 ),
             });
         }
-        ok &= AddLine(line);
+        ok &= AddLineToNetwork(line);
         if (!ok) {
             throw std::runtime_error("Could not add line " + line.id);
         }
@@ -202,88 +1007,457 @@ bool TransportNetwork::FromJson(
 
     // Finally, set the travel times.
     for (auto&& travelTimeJson: src.at("travel_times")) {
-        ok &= SetTravelTime(
+        const auto& travelTime {travelTimeJson.at("travel_time")};
+        if (!travelTime.is_number_unsigned() ||
+            travelTime.get<std::uint64_t>() >
+                std::numeric_limits<unsigned int>::max()) {
+            throw std::runtime_error(kBadTravelTimeError);
+        }
+        ok &= SetTravelTimeInNetwork(
             std::move(travelTimeJson.at("start_station_id").get<std::string>()),
             std::move(travelTimeJson.at("end_station_id").get<std::string>()),
-            std::move(travelTimeJson.at("travel_time").get<unsigned int>())
+            travelTime.get<unsigned int>()
         );
     }
 
+    // We only build the compact graph once all items are in.
+    BuildGraph();
+
     return ok;
 }
 
-bool TransportNetwork::AddStation(
-    const Station& station
+bool TransportNetwork::FromJsonFile(
+    const std::filesystem::path& file
 )
 {
-    // Cannot add a station that is already in the network.
-    if (GetStation(station.id) != nullptr) {
-        return false;
+    std::ifstream src {file, std::ios::binary};
+    if (!src) {
+        throw std::runtime_error("Could not open " + file.string());
     }
+    LayoutSaxHandler handler {*this};
+    nlohmann::json::sax_parse(src, &handler);
+    const bool ok {handler.Finish()};
 
-    // Create a new station node and add it to the map.
-    auto node {std::make_shared<GraphNode>(GraphNode {
-        station.id,
-        station.name,
-        0, // We start with no passengers.
-        {} // We start with no edges.
-    })};
-    stations_.emplace(station.id, std::move(node));
+    // We only build the compact graph once all items are in.
+    BuildGraph();
 
-    return true;
+    return ok;
 }
 
-bool TransportNetwork::AddLine(
-    const Line& line
+bool TransportNetwork::FromJsonBuffer(
+    std::string_view src
 )
 {
-    // Cannot add a line that is already in the network.
-    if (GetLine(line.id) != nullptr) {
-        return false;
-    }
+    LayoutSaxHandler handler {*this};
+    nlohmann::json::sax_parse(src.data(), src.data() + src.size(), &handler);
+    const bool ok {handler.Finish()};
 
-    // Create the internal version of the line.
-    auto lineInternal {std::make_shared<LineInternal>(LineInternal {
-        line.id,
-        line.name,
-        {} // We will add routes shortly.
-    })};
+    // We only build the compact graph once all items are in.
+    BuildGraph();
 
-    // Add the routes to the line.
-    for (const auto& route: line.routes) {
-        bool ok {AddRouteToLine(route, lineInternal)};
-        if (!ok) {
+    return ok;
+}
+
+bool TransportNetwork::SaveSnapshot(
+    const std::filesystem::path& file
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+
+    // String table
+    std::vector<std::uint32_t> stringOffsets {0};
+    std::vector<char> stringChars {};
+    auto addString {[&stringOffsets, &stringChars](const std::string& str) {
+        stringChars.insert(stringChars.end(), str.begin(), str.end());
+        stringOffsets.push_back(static_cast<std::uint32_t>(stringChars.size()));
+        return static_cast<std::uint32_t>(stringOffsets.size() - 2);
+    }};
+    std::vector<SnapshotStation> stations {};
+    stations.reserve(stationNodes_.size());
+    for (const auto& station: stationNodes_) {
+        const auto id {addString(station->id)};
+        stations.push_back({id, addString(station->name)});
+    }
+    std::vector<SnapshotLine> lines {};
+    lines.reserve(lineNodes_.size());
+    for (const auto& line: lineNodes_) {
+        const auto id {addString(line->id)};
+        lines.push_back({id, addString(line->name)});
+    }
+    std::vector<SnapshotRoute> routes {};
+    std::vector<std::uint32_t> routeStops {};
+    routes.reserve(routeNodes_.size());
+    for (const auto& route: routeNodes_) {
+        routes.push_back({addString(route->id), route->line->index});
+        for (const auto& stop: route->stops) {
+            routeStops.push_back(stop->index);
+        }
+    }
+
+    // We fill the header and the section table once we have all sections.
+    std::vector<char> data(kSnapshotSectionsEnd, 0);
+    using Section = SnapshotSection;
+    AppendSnapshotSection(data, Section::kStringOffsets, stringOffsets);
+    AppendSnapshotSection(data, Section::kStringChars, stringChars);
+    AppendSnapshotSection(data, Section::kStations, stations);
+    AppendSnapshotSection(data, Section::kLines, lines);
+    AppendSnapshotSection(data, Section::kRoutes, routes);
+    AppendSnapshotSection(data, Section::kRouteStopOffsets,
+                          graph.routeStopOffsets);
+    AppendSnapshotSection(data, Section::kRouteStops, routeStops);
+    AppendSnapshotSection(data, Section::kEdgeOffsets, graph.edgeOffsets);
+    AppendSnapshotSection(data, Section::kEdges, graph.edges);
+    AppendSnapshotSection(data, Section::kStateStations, graph.stateStations);
+    AppendSnapshotSection(data, Section::kEdgeStates, graph.edgeStates);
+    AppendSnapshotSection(data, Section::kStateArcOffsets,
+                          graph.stateArcOffsets);
+    AppendSnapshotSection(data, Section::kStateArcs, graph.stateArcs);
+    AppendSnapshotSection(data, Section::kStateRouteStops,
+                          graph.stateRouteStops);
+    AppendSnapshotSection(data, Section::kLandmarks, graph.landmarks);
+    AppendSnapshotSection(data, Section::kLandmarkDistFrom,
+                          graph.landmarkDistFrom);
+    AppendSnapshotSection(data, Section::kLandmarkDistTo,
+                          graph.landmarkDistTo);
+
+    SnapshotHeader header {};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.layoutVersion = kSnapshotLayoutVersion;
+    header.byteOrderMark = kSnapshotByteOrderMark;
+    header.fileSize = data.size();
+    header.checksum = GetSnapshotChecksum(
+        data.data() + sizeof(SnapshotHeader),
+        data.size() - sizeof(SnapshotHeader)
+    );
+    header.routeChangePenalty = graph.routeChangePenalty;
+    header.nRouteStates = static_cast<std::uint32_t>(graph.nRouteStates);
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    // Write to a temporary file, then move it in place.
+    auto tmpFile {file};
+    tmpFile += ".tmp";
+    {
+        std::ofstream out {tmpFile, std::ios::binary | std::ios::trunc};
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
             return false;
         }
     }
+    std::error_code ec {};
+    std::filesystem::rename(tmpFile, file, ec);
+    return !ec;
+}
+
+bool TransportNetwork::LoadSnapshot(
+    const std::filesystem::path& file
+)
+{
+    // We can only load a snapshot into an empty network.
+    if (!stationNodes_.empty() || !lineNodes_.empty()) {
+        return false;
+    }
 
-    // Only add the line to the map when we are sure that there were no errors.
-    lines_.emplace(line.id, std::move(lineInternal));
+    // Map the snapshot in memory.
+    namespace bip = boost::interprocess;
+    bip::mapped_region region {};
+    try {
+        const bip::file_mapping mapping {file.string().c_str(), bip::read_only};
+        region = bip::mapped_region {mapping, bip::read_only};
+    } catch (const bip::interprocess_exception& e) {
+        spdlog::warn("Could not map snapshot {}: {}", file.string(), e.what());
+        return false;
+    }
+    const auto* data {static_cast<const char*>(region.get_address())};
+    const auto size {region.get_size()};
+
+    // Reject stale or corrupt snapshots.
+    SnapshotHeader header {};
+    if (size < kSnapshotSectionsEnd) {
+        spdlog::warn("Snapshot {} is truncated", file.string());
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+        header.layoutVersion != kSnapshotLayoutVersion ||
+        header.byteOrderMark != kSnapshotByteOrderMark) {
+        spdlog::warn("Snapshot {} has a different layout", file.string());
+        return false;
+    }
+    if (header.fileSize != size ||
+        header.checksum != GetSnapshotChecksum(
+            data + sizeof(SnapshotHeader),
+            size - sizeof(SnapshotHeader)
+        )) {
+        spdlog::warn("Snapshot {} is corrupt", file.string());
+        return false;
+    }
+
+    // Copy the sections out.
+    std::vector<std::uint32_t> stringOffsets {};
+    std::vector<char> stringChars {};
+    std::vector<SnapshotStation> stations {};
+    std::vector<SnapshotLine> lines {};
+    std::vector<SnapshotRoute> routes {};
+    std::vector<std::uint32_t> routeStopOffsets {};
+    std::vector<std::uint32_t> routeStops {};
+    std::vector<std::uint32_t> edgeOffsets {};
+    std::vector<Graph::Edge> edges {};
+    Graph graph {};
+    using Section = SnapshotSection;
+    bool ok {true};
+    auto read {[data, size, &ok](const Section section, auto& items) {
+        ok &= ReadSnapshotSection(data, size, section, items);
+    }};
+    read(Section::kStringOffsets, stringOffsets);
+    read(Section::kStringChars, stringChars);
+    read(Section::kStations, stations);
+    read(Section::kLines, lines);
+    read(Section::kRoutes, routes);
+    read(Section::kRouteStops, routeStops);
+    read(Section::kEdges, edges);
+    read(Section::kRouteStopOffsets, routeStopOffsets);
+    read(Section::kEdgeOffsets, edgeOffsets);
+    read(Section::kStateStations, graph.stateStations);
+    read(Section::kEdgeStates, graph.edgeStates);
+    read(Section::kStateArcOffsets, graph.stateArcOffsets);
+    read(Section::kStateArcs, graph.stateArcs);
+    read(Section::kStateRouteStops, graph.stateRouteStops);
+    read(Section::kLandmarks, graph.landmarks);
+    read(Section::kLandmarkDistFrom, graph.landmarkDistFrom);
+    read(Section::kLandmarkDistTo, graph.landmarkDistTo);
+    if (!ok) {
+        spdlog::warn("Snapshot {} is corrupt", file.string());
+        return false;
+    }
+
+    // Check that all references between items are valid, so that a bad
+    // snapshot with a valid checksum cannot send us out of bounds.
+    const auto nStrings {stringOffsets.size() - 1};
+    const auto nStations {stations.size()};
+    const auto nRoutes {routes.size()};
+    const auto nStates {graph.stateStations.size()};
+    const auto nRouteStates {static_cast<size_t>(header.nRouteStates)};
+    ok = !stringOffsets.empty() &&
+        AreSnapshotOffsets(stringOffsets, nStrings, stringChars.size());
+    for (const auto& item: stations) {
+        ok &= item.id < nStrings && item.name < nStrings;
+    }
+    for (const auto& item: lines) {
+        ok &= item.id < nStrings && item.name < nStrings;
+    }
+    for (const auto& item: routes) {
+        ok &= item.id < nStrings && item.line < lines.size();
+    }
+    ok &= AreSnapshotOffsets(routeStopOffsets, nRoutes, routeStops.size()) &&
+        AreSnapshotIndices(routeStops, nStations);
+    for (size_t route {0}; ok && route < nRoutes; ++route) {
+        ok &= routeStopOffsets[route + 1] -
+            routeStopOffsets[route] >= 2;
+    }
+    ok &= AreSnapshotOffsets(edgeOffsets, nStations, edges.size());
+    for (const auto& edge: edges) {
+        ok &= edge.nextStop < nStations && edge.route < nRoutes;
+    }
+    ok &= nRouteStates + nStations == nStates &&
+        AreSnapshotIndices(graph.stateStations, nStations) &&
+        graph.edgeStates.size() == edges.size() &&
+        AreSnapshotIndices(graph.edgeStates, nRouteStates) &&
+        AreSnapshotOffsets(graph.stateArcOffsets, nStates,
+                           graph.stateArcs.size()) &&
+        graph.stateRouteStops.size() == nRouteStates &&
+        AreSnapshotIndices(graph.stateRouteStops, routeStops.size());
+
+    // Route states sit at a stop of their route, and departure states come
+    // after them in station order.
+    for (size_t state {0}; ok && state < nRouteStates; ++state) {
+        ok &= routeStops[graph.stateRouteStops[state]] ==
+            graph.stateStations[state];
+    }
+    for (size_t station {0}; ok && station < nStations; ++station) {
+        ok &= graph.stateStations[nRouteStates + station] == station;
+    }
+    for (const auto& arc: graph.stateArcs) {
+        ok &= arc.nextState < nStates &&
+            (arc.edge < edges.size() || arc.edge == kNoEdge);
+    }
+    ok &= AreSnapshotIndices(graph.landmarks, nStations) &&
+        graph.landmarks.size() <= kNLandmarks &&
+        graph.landmarkDistFrom.size() == nStations * graph.landmarks.size() &&
+        graph.landmarkDistTo.size() == nStations * graph.landmarks.size();
+    if (!ok) {
+        spdlog::warn("Snapshot {} is inconsistent", file.string());
+        return false;
+    }
+
+    // Rebuild the stations, lines and routes.
+    auto getString {[&stringOffsets, &stringChars](const std::uint32_t idx) {
+        return std::string(
+            stringChars.data() + stringOffsets[idx],
+            stringOffsets[idx + 1] - stringOffsets[idx]
+        );
+    }};
+    for (const auto& station: stations) {
+        ok &= AddStationToNetwork({getString(station.id),
+                                   getString(station.name)});
+    }
+    for (const auto& line: lines) {
+        auto lineInternal {std::make_shared<LineInternal>(LineInternal {
+            getString(line.id),
+            getString(line.name),
+            {}, // We will add routes shortly.
+            static_cast<std::uint32_t>(lineNodes_.size()),
+        })};
+        lineNodes_.push_back(lineInternal);
+        ok &= lines_.emplace(lineInternal->id, std::move(lineInternal)).second;
+    }
+    for (std::uint32_t route {0}; ok && route < nRoutes; ++route) {
+        std::vector<std::shared_ptr<GraphNode>> stops {};
+        for (auto idx {routeStopOffsets[route]};
+             idx < routeStopOffsets[route + 1]; ++idx) {
+            stops.push_back(stationNodes_[routeStops[idx]]);
+        }
+        auto routeInternal {std::make_shared<RouteInternal>(RouteInternal {
+            getString(routes[route].id),
+            lineNodes_[routes[route].line],
+            std::move(stops),
+            route,
+        })};
+        routeNodes_.push_back(routeInternal);
+        for (const auto& stop: routeInternal->stops) {
+            auto& stopRoutes {stop->routes};
+            if (std::find(stopRoutes.begin(), stopRoutes.end(),
+                          route) == stopRoutes.end()) {
+                stopRoutes.push_back(route);
+            }
+        }
+        ok &= routeInternal->line->routes.emplace(
+            routeInternal->id,
+            routeInternal
+        ).second;
+    }
+    if (!ok) {
+        spdlog::warn("Snapshot {} has duplicate IDs", file.string());
+        ClearNetwork();
+        return false;
+    }
+
+    // Rebuild the edges, in the same order as in the compact graph.
+    for (std::uint32_t station {0}; station < nStations; ++station) {
+        auto& stationEdges {stationNodes_[station]->edges};
+        for (auto idx {edgeOffsets[station]};
+             idx < edgeOffsets[station + 1]; ++idx) {
+            const auto& [nextStop, route, travelTime] = edges[idx];
+            stationEdges.emplace_back(std::make_shared<GraphEdge>(GraphEdge {
+                routeNodes_[route],
+                stationNodes_[nextStop],
+                travelTime,
+            }));
+        }
+    }
+
+    // The snapshot has the search graph and the landmarks, but we rebuild the
+    // route-expanded graph if the route change penalty changed since then.
+    BuildGraphTables(graph);
+    if (header.routeChangePenalty == routeChangePenalty_) {
+        graph.nRouteStates = nRouteStates;
+        graph.routeChangePenalty = header.routeChangePenalty;
+    } else {
+        graph.stateStations.clear();
+        graph.edgeStates.clear();
+        graph.stateArcOffsets.assign(1, 0);
+        graph.stateArcs.clear();
+        graph.stateRouteStops.clear();
+        BuildStateGraph(graph, routeChangePenalty_);
+    }
+    graph.goalDirectedSearch = goalDirectedSearch_;
+    graph.quietRouteCrowdingTolerancePc = quietRouteCrowdingTolerancePc_;
+    graph.withAllPairs = precomputeFastestTravelRoutes_;
+    graph.withContractionHierarchy = precomputeContractionHierarchy_;
+    PublishGraph(std::move(graph));
 
     return true;
 }
 
+bool TransportNetwork::AddStation(
+    const Station& station
+)
+{
+    bool ok {AddStationToNetwork(station)};
+    if (ok) {
+        BuildGraph();
+    }
+    return ok;
+}
+
+bool TransportNetwork::AddLine(
+    const Line& line
+)
+{
+    bool ok {AddLineToNetwork(line)};
+    if (ok) {
+        BuildGraph();
+    }
+    return ok;
+}
+
 bool TransportNetwork::RecordPassengerEvent(
     const PassengerEvent& event
 )
 {
     // Find the station.
-    const auto stationNode {GetStation(event.stationId)};
-    if (stationNode == nullptr) {
+    const auto graph {LoadGraph()};
+    const auto stationIt {graph->stationHandles.find(event.stationId)};
+    if (stationIt == graph->stationHandles.end()) {
         return false;
     }
 
-    // Increase or decrease the passenger count at the station.
+    // Events with no timestamp happen at the latest event time.
+    auto& passengerCounts {*graph->passengerCounts};
+    auto time {passengerCounts.GetLatestTime()};
+    if (!event.timestamp.is_special()) {
+        const auto seconds {
+            (event.timestamp - boost::posix_time::from_time_t(0))
+                .total_seconds()
+        };
+        time = static_cast<std::uint32_t>(std::clamp<long long int>(
+            seconds,
+            0,
+            std::numeric_limits<std::uint32_t>::max()
+        ));
+    }
+
+    // Find the route stop, if the event has a route.
+    auto routeStop {kNoEdge};
+    if (!event.routeId.empty()) {
+        const auto routeIt {graph->routeHandles.find(event.routeId)};
+        if (routeIt == graph->routeHandles.end()) {
+            return false;
+        }
+        routeStop = GetRouteStop(*graph, stationIt->second, routeIt->second);
+        if (routeStop == kNoEdge) {
+            return false;
+        }
+    }
+
+    // Increase or decrease the passenger count at the station or route stop.
+    long long int nPassengers {0};
     switch (event.type) {
         case PassengerEvent::Type::In:
-            ++stationNode->passengerCount;
-            return true;
+            nPassengers = 1;
+            break;
         case PassengerEvent::Type::Out:
-            --stationNode->passengerCount;
-            return true;
+            nPassengers = -1;
+            break;
         default:
             return false;
     }
+    if (routeStop == kNoEdge) {
+        passengerCounts.Add(stationIt->second, nPassengers, time);
+    } else {
+        passengerCounts.AddAtRouteStop(routeStop, nPassengers, time);
+    }
+    return true;
 }
 
 long long int TransportNetwork::GetPassengerCount(
@@ -291,12 +1465,21 @@ long long int TransportNetwork::GetPassengerCount(
 ) const
 {
     // Find the station.
-    const auto stationNode {GetStation(station)};
-    if (stationNode == nullptr) {
+    const auto graph {LoadGraph()};
+    const auto stationIt {graph->stationHandles.find(station)};
+    if (stationIt == graph->stationHandles.end()) {
         throw std::runtime_error("Could not find station in the network: " +
                                  station);
     }
-    return stationNode->passengerCount;
+    const auto& passengerCounts {*graph->passengerCounts};
+    auto passengerCount {passengerCounts.Get(stationIt->second)};
+    for (const auto& route: graph->stationRoutes[stationIt->second]) {
+        const auto routeStop {GetRouteStop(*graph, stationIt->second, route)};
+        if (routeStop != kNoEdge) {
+            passengerCount += passengerCounts.GetAtRouteStop(routeStop);
+        }
+    }
+    return passengerCount;
 }
 
 std::vector<Id> TransportNetwork::GetRoutesServingStation(
@@ -304,37 +1487,33 @@ std::vector<Id> TransportNetwork::GetRoutesServingStation(
 ) const
 {
     // Find the station.
-    const auto stationNode {GetStation(station)};
-    if (stationNode == nullptr) {
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    const auto stationIt {graph.stationHandles.find(station)};
+    if (stationIt == graph.stationHandles.end()) {
         return {};
     }
 
+    const auto& stationRoutes {graph.stationRoutes[stationIt->second]};
     std::vector<Id> routes {};
-
-    // Iterate over all edges departing from the node. Each edge corresponds to
-    // one route serving the station.
-    const auto& edges {stationNode->edges};
-    for (const auto& edge: edges) {
-        routes.push_back(edge->route->id);
+    routes.reserve(stationRoutes.size());
+    for (const auto route: stationRoutes) {
+        routes.push_back(graph.routeIds[route]);
     }
+    return routes;
+}
 
-    // The previous loop misses a corner case: The end station of a route does
-    // not have any edge containing that route, because we only track the routes
-    // that *leave from*, not *arrive to* a certain station.
-    // We need to loop over all line routes to check if our station is the end
-    // stop of any route.
-    // FIXME: In the worst case, we are iterating over all routes for all
-    //        lines in the network. We may want to optimize this.
-    for (const auto& [_, line]: lines_) {
-        for (const auto& [_, route]: line->routes) {
-            const auto& endStop {route->stops[route->stops.size() - 1]};
-            if (stationNode == endStop) {
-                routes.push_back(route->id);
-            }
-        }
+std::vector<RouteHandle> TransportNetwork::GetRoutesServingStation(
+    const StationHandle station
+) const
+{
+    // We return a copy: The graph may go away as soon as the network changes.
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    if (station >= graph.stationRoutes.size()) {
+        return {};
     }
-
-    return routes;
+    return graph.stationRoutes[station];
 }
 
 bool TransportNetwork::SetTravelTime(
@@ -342,6 +1521,21 @@ bool TransportNetwork::SetTravelTime(
     const Id& stationB,
     const unsigned int travelTime
 )
+{
+    // Travel times feed into the landmark distances, so we rebuild the whole
+    // compact graph.
+    bool ok {SetTravelTimeInNetwork(stationA, stationB, travelTime)};
+    if (ok) {
+        BuildGraph();
+    }
+    return ok;
+}
+
+bool TransportNetwork::SetTravelTimeInNetwork(
+    const Id& stationA,
+    const Id& stationB,
+    const unsigned int travelTime
+)
 {
     // Find the stations.
     const auto stationANode {GetStation(stationA)};
@@ -352,6 +1546,8 @@ bool TransportNetwork::SetTravelTime(
 
     // Search all edges connecting A -> B and B -> A.
     // We use a lambda to avoid code duplication.
+    // Queries never read these edges: They only see the new travel time once
+    // we publish the next graph.
     bool foundAnyEdge {false};
     auto setTravelTime {[&foundAnyEdge, &travelTime](auto from, auto to) {
         for (auto& edge: from->edges) {
@@ -373,27 +1569,33 @@ unsigned int TransportNetwork::GetTravelTime(
 ) const
 {
     // Find the stations.
-    const auto stationANode {GetStation(stationA)};
-    const auto stationBNode {GetStation(stationB)};
-    if (stationANode == nullptr || stationBNode == nullptr) {
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    const auto stationAIt {graph.stationHandles.find(stationA)};
+    const auto stationBIt {graph.stationHandles.find(stationB)};
+    if (stationAIt == graph.stationHandles.end() ||
+        stationBIt == graph.stationHandles.end()) {
         return 0;
     }
 
     // Check if there is an edge A -> B, then B -> A.
-    // We can return early as soon as we find a match: Wwe know that the travel
+    // We can return early as soon as we find a match: We know that the travel
     // time from A to B is the same as the travel time from B to A, across all
     // routes.
-    for (const auto& edge: stationANode->edges) {
-        if (edge->nextStop == stationBNode) {
-            return edge->travelTime;
-        }
-    }
-    for (const auto& edge: stationBNode->edges) {
-        if (edge->nextStop == stationANode) {
-            return edge->travelTime;
+    auto findEdge {[&graph](const auto from, const auto to) {
+        const auto edgesEnd {graph.edgeOffsets[from + 1]};
+        for (auto idx {graph.edgeOffsets[from]}; idx < edgesEnd; ++idx) {
+            if (graph.edges[idx].nextStop == to) {
+                return idx;
+            }
         }
+        return kNoEdge;
+    }};
+    auto edge {findEdge(stationAIt->second, stationBIt->second)};
+    if (edge == kNoEdge) {
+        edge = findEdge(stationBIt->second, stationAIt->second);
     }
-    return 0;
+    return edge != kNoEdge ? graph.edges[edge].travelTime : 0;
 }
 
 unsigned int TransportNetwork::GetTravelTime(
@@ -403,47 +1605,187 @@ unsigned int TransportNetwork::GetTravelTime(
     const Id& stationB
 ) const
 {
-    // Find the route.
-    const auto routeInternal {GetRoute(line, route)};
-    if (routeInternal == nullptr) {
+    // Find the line and the route, which must be on that line.
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    const auto lineIt {graph.lineHandles.find(line)};
+    const auto routeIt {graph.routeHandles.find(route)};
+    if (lineIt == graph.lineHandles.end() ||
+        routeIt == graph.routeHandles.end() ||
+        graph.routeLines[routeIt->second] != lineIt->second) {
         return 0;
     }
 
     // Find the stations.
-    const auto stationANode {GetStation(stationA)};
-    const auto stationBNode {GetStation(stationB)};
-    if (stationANode == nullptr || stationBNode == nullptr) {
+    const auto stationAIt {graph.stationHandles.find(stationA)};
+    const auto stationBIt {graph.stationHandles.find(stationB)};
+    if (stationAIt == graph.stationHandles.end() ||
+        stationBIt == graph.stationHandles.end()) {
         return 0;
     }
 
-    // Walk the route looking for station A.
-    unsigned int travelTime {0};
-    bool foundA {false};
-    for (const auto& stop: routeInternal->stops) {
-        // If we found station A, we start counting.
-        if (stop == stationANode) {
-            foundA = true;
-        }
+    // Find the stops of the stations along the route. Route stops are in route
+    // order, so B must have the higher one.
+    const auto routeStopA {
+        GetRouteStop(graph, stationAIt->second, routeIt->second)
+    };
+    const auto routeStopB {
+        GetRouteStop(graph, stationBIt->second, routeIt->second)
+    };
+    if (routeStopA == kNoEdge || routeStopB == kNoEdge ||
+        routeStopA >= routeStopB) {
+        // We didn't find station A, B, or both, or B comes before A.
+        return 0;
+    }
 
-        // If we found station B, we return the cumulative travel time so far.
-        if (stop == stationBNode) {
-            return travelTime;
-        }
+    const auto& travelTimes {graph.routeStopTravelTimes};
+    return travelTimes[routeStopB] - travelTimes[routeStopA];
+}
 
-        // Accummulate the travel time since we found station A..
-        if (foundA) {
-            auto edgeIt {stop->FindEdgeForRoute(routeInternal)};
-            if (edgeIt == stop->edges.end()) {
-                // Unexpected: The station should definitely have an edge for
-                //             this route.
-                return 0;
-            }
-            travelTime += (*edgeIt)->travelTime;
-        }
+void TransportNetwork::SetGoalDirectedSearch(
+    const bool enabled
+)
+{
+    goalDirectedSearch_ = enabled;
+    auto graph {*LoadGraph()};
+    graph.goalDirectedSearch = enabled;
+    PublishGraph(std::move(graph));
+}
+
+void TransportNetwork::SetRouteChangePenalty(
+    const unsigned int penalty
+)
+{
+    routeChangePenalty_ = penalty;
+    BuildGraph();
+}
+
+unsigned int TransportNetwork::GetRouteChangePenalty() const
+{
+    return LoadGraph()->routeChangePenalty;
+}
+
+void TransportNetwork::SetQuietRouteSearchThreads(
+    const size_t nThreads
+)
+{
+    if (nThreads > 1) {
+        spurSearchPool_ = std::make_shared<boost::asio::thread_pool>(nThreads);
+    } else {
+        spurSearchPool_.reset();
+    }
+}
+
+void TransportNetwork::SetBatchQueryThreads(
+    const size_t nThreads
+)
+{
+    batchQueryPool_ = std::make_shared<boost::asio::thread_pool>(
+        std::max<size_t>(1, nThreads)
+    );
+}
+
+void TransportNetwork::SetRouteCacheCapacity(
+    const size_t capacity
+)
+{
+    routeCache_.SetCapacity(capacity);
+}
+
+void TransportNetwork::SetQuietRouteCrowdingTolerance(
+    const double tolerancePc
+)
+{
+    quietRouteCrowdingTolerancePc_ = std::max(0.0, tolerancePc);
+    auto graph {*LoadGraph()};
+    graph.quietRouteCrowdingTolerancePc = quietRouteCrowdingTolerancePc_;
+    PublishGraph(std::move(graph));
+}
+
+void TransportNetwork::SetCrowdingHalfLife(
+    const boost::posix_time::time_duration& halfLife
+)
+{
+    LoadGraph()->passengerCounts->SetHalfLife(std::max(
+        1.0,
+        halfLife.total_milliseconds() / 1000.0
+    ));
+}
+
+size_t TransportNetwork::GetRouteCacheHits() const
+{
+    return routeCache_.GetNHits();
+}
+
+size_t TransportNetwork::GetRouteCacheMisses() const
+{
+    return routeCache_.GetNMisses();
+}
+
+void TransportNetwork::PrecomputeFastestTravelRoutes()
+{
+    precomputeFastestTravelRoutes_ = true;
+    auto graph {*LoadGraph()};
+    graph.withAllPairs = true;
+    PublishGraph(std::move(graph));
+    GetGraphIndexes(*LoadGraph(), true);
+}
+
+void TransportNetwork::PrecomputeContractionHierarchy()
+{
+    precomputeContractionHierarchy_ = true;
+    auto graph {*LoadGraph()};
+    graph.withContractionHierarchy = true;
+    PublishGraph(std::move(graph));
+    GetGraphIndexes(*LoadGraph(), true);
+}
+
+size_t TransportNetwork::GetContractionHierarchyMemoryUsage() const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& indexes {*graphSnapshot->indexes};
+    if (!indexes.hasContractionHierarchy ||
+        indexes.contractionHierarchy.IsEmpty()) {
+        return 0;
+    }
+    return indexes.contractionHierarchy.GetMemoryUsage();
+}
+
+StationHandle TransportNetwork::LookupStation(
+    const Id& station
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    auto stationIt {graph.stationHandles.find(station)};
+    if (stationIt == graph.stationHandles.end()) {
+        return kInvalidStationHandle;
     }
+    return stationIt->second;
+}
+
+Id TransportNetwork::GetStationId(
+    const StationHandle station
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    if (station >= graph.stationIds.size()) {
+        return {};
+    }
+    return graph.stationIds[station];
+}
 
-    // If we got here, we didn't find station A, B, or both.
-    return 0;
+Id TransportNetwork::GetRouteId(
+    const RouteHandle route
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    if (route >= graph.routeIds.size()) {
+        return {};
+    }
+    return graph.routeIds[route];
 }
 
 TravelRoute TransportNetwork::GetFastestTravelRoute(
@@ -451,13 +1793,52 @@ TravelRoute TransportNetwork::GetFastestTravelRoute(
     const Id& stationBId
 ) const
 {
-    // Find the stations.
-    const auto stationA {GetStation(stationAId)};
-    const auto stationB {GetStation(stationBId)};
-    if (stationA == nullptr || stationB == nullptr) {
+    return GetFastestTravelRoute(
+        LookupStation(stationAId),
+        LookupStation(stationBId)
+    );
+}
+
+TravelRoute TransportNetwork::GetFastestTravelRoute(
+    const StationHandle stationA,
+    const StationHandle stationB
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    RouteCacheKey key {};
+    key.stationA = stationA;
+    key.stationB = stationB;
+    std::shared_ptr<const RouteCacheEntry> cached {};
+    const auto isFresh {[&graph](
+        const std::shared_ptr<const RouteCacheEntry>& cached
+    ) {
+        return cached->graphVersion == graph.version;
+    }};
+    if (routeCache_.Get(key, cached, isFresh)) {
+        return cached->travelRoute;
+    }
+    auto entry {std::make_shared<RouteCacheEntry>()};
+    entry->travelRoute = FindFastestTravelRoute(graph, stationA, stationB);
+    entry->graphVersion = graph.version;
+    routeCache_.Put(key, entry);
+    return entry->travelRoute;
+}
+
+TravelRoute TransportNetwork::FindFastestTravelRoute(
+    const Graph& graph,
+    const StationHandle stationA,
+    const StationHandle stationB
+) const
+{
+    // Check the stations.
+    const auto nStations {graph.stationIds.size()};
+    if (stationA >= nStations || stationB >= nStations) {
         return TravelRoute {};
     }
-    spdlog::info("GetFastestTravelRoute: {} -> {}", stationA->id, stationB->id);
+    const auto& stationAId {graph.stationIds[stationA]};
+    const auto& stationBId {graph.stationIds[stationB]};
+    spdlog::info("GetFastestTravelRoute: {} -> {}", stationAId, stationBId);
 
     // Corner case: A and B are the same station.
     if (stationA == stationB) {
@@ -476,10 +1857,7 @@ TravelRoute TransportNetwork::GetFastestTravelRoute(
     }
 
     // Get the fastest path from A to B.
-    const auto path {GetFastestTravelRoute(
-        {{stationA, nullptr}, 0},
-        stationB
-    )};
+    const auto path {GetFastestPath(graph, stationA, stationB)};
 
     // Corner case: There is no valid path between A and B.
     if (path.empty()) {
@@ -491,29 +1869,7 @@ TravelRoute TransportNetwork::GetFastestTravelRoute(
         };
     }
 
-    // Assemble the path.
-    // Note: We go in reverse order, from B to A, because this is how the
-    //       previousStop map is structured.
-    const auto& totalTravelTime {path.back().second};
-    TravelRoute travelRoute {
-        stationAId,
-        stationBId,
-        totalTravelTime,
-        {},
-    };
-    travelRoute.steps.reserve(path.size());
-    for (size_t idx {1}; idx < path.size(); ++idx) {
-        const auto& prevStop {path[idx - 1].first};
-        const auto& currStop {path[idx].first};
-        travelRoute.steps.push_back(TravelRoute::Step {
-            prevStop.node->id,
-            currStop.node->id,
-            currStop.edge->route->line->id,
-            currStop.edge->route->id,
-            currStop.edge->travelTime,
-        });
-    }
-    return travelRoute;
+    return GetTravelRoute(graph, path);
 }
 
 TravelRoute TransportNetwork::GetQuietTravelRoute(
@@ -521,41 +1877,206 @@ TravelRoute TransportNetwork::GetQuietTravelRoute(
     const Id& stationBId,
     const double maxSlowdownPc,
     const double minQuietnessPc,
-    const size_t maxNPaths
+    const size_t maxNPaths,
+    const QuietRouteSearch search,
+    const CrowdingModel model
 ) const
 {
-    // Find the stations.
-    const auto stationA {GetStation(stationAId)};
-    const auto stationB {GetStation(stationBId)};
-    if (stationA == nullptr || stationB == nullptr) {
-        return TravelRoute {};
-    }
-    spdlog::info("GetQuietTravelRoute: {} -> {}", stationA->id, stationB->id);
-
-    // Corner case: A and B are the same station.
-    if (stationA == stationB) {
-        return TravelRoute {
-            stationAId,
-            stationAId,
-            0,
-            {TravelRoute::Step {
-                stationAId,
-                stationAId,
-                {},
-                {},
-                0
-            }},
-        };
-    }
-
-    // Get all the paths within a certain travel time threshold.
-    // These are all valid candidates for the most quiet route.
-    auto paths {GetFastestTravelRoutes(
-        stationA,
-        stationB,
+    return GetQuietTravelRoute(
+        LookupStation(stationAId),
+        LookupStation(stationBId),
         maxSlowdownPc,
-        maxNPaths
-    )};
+        minQuietnessPc,
+        maxNPaths,
+        search,
+        model
+    );
+}
+
+TravelRoute TransportNetwork::GetQuietTravelRoute(
+    const StationHandle stationA,
+    const StationHandle stationB,
+    const double maxSlowdownPc,
+    const double minQuietnessPc,
+    const size_t maxNPaths,
+    const QuietRouteSearch search,
+    const CrowdingModel model
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    const RouteCacheKey key {
+        true,
+        stationA,
+        stationB,
+        maxSlowdownPc,
+        minQuietnessPc,
+        maxNPaths,
+        search,
+        model,
+    };
+    std::shared_ptr<const RouteCacheEntry> cached {};
+    const auto tolerancePc {graph.quietRouteCrowdingTolerancePc};
+    const auto crowdingEpoch {graph.passengerCounts->GetEpoch()};
+    const auto isFresh {[this, &graph, model, tolerancePc, crowdingEpoch](
+        const std::shared_ptr<const RouteCacheEntry>& cached
+    ) {
+        if (cached->graphVersion != graph.version) {
+            return false;
+        }
+        if (cached->crowdingEpoch == crowdingEpoch) {
+            return true;
+        }
+
+        // Without candidate paths, any change in crowding can change the
+        // route.
+        if (tolerancePc <= 0.0 || cached->candidatePaths.empty()) {
+            return false;
+        }
+
+        // Re-score the candidate paths against the current crowding.
+        for (size_t idx {0}; idx < cached->candidatePaths.size(); ++idx) {
+            const double oldCrowding {
+                static_cast<double>(cached->candidateCrowding[idx])
+            };
+            const auto& path {cached->candidatePaths[idx]};
+            const double newCrowding {
+                static_cast<double>(GetPathCrowding(graph, model, path))
+            };
+            if (std::abs(newCrowding - oldCrowding) >
+                    tolerancePc * oldCrowding) {
+                return false;
+            }
+        }
+        return true;
+    }};
+    if (routeCache_.Get(key, cached, isFresh)) {
+        return cached->travelRoute;
+    }
+
+    // Only the k fastest paths cover all the candidates for the quiet route,
+    // so we only keep them for kYen.
+    const bool keepCandidates {
+        tolerancePc > 0.0 && search == QuietRouteSearch::kYen
+    };
+    auto entry {std::make_shared<RouteCacheEntry>()};
+    entry->travelRoute = FindQuietTravelRoute(
+        graph,
+        stationA,
+        stationB,
+        maxSlowdownPc,
+        minQuietnessPc,
+        maxNPaths,
+        search,
+        model,
+        keepCandidates ? &entry->candidatePaths : nullptr
+    );
+    entry->graphVersion = graph.version;
+    entry->crowdingEpoch = crowdingEpoch;
+    entry->candidateCrowding.reserve(entry->candidatePaths.size());
+    for (const auto& path: entry->candidatePaths) {
+        entry->candidateCrowding.push_back(
+            GetPathCrowding(graph, model, path)
+        );
+    }
+    routeCache_.Put(key, entry);
+    return entry->travelRoute;
+}
+
+TravelRoute TransportNetwork::FindQuietTravelRoute(
+    const Graph& graph,
+    const StationHandle stationA,
+    const StationHandle stationB,
+    const double maxSlowdownPc,
+    const double minQuietnessPc,
+    const size_t maxNPaths,
+    const QuietRouteSearch search,
+    const CrowdingModel model,
+    std::vector<Path>* candidatePaths
+) const
+{
+    // Check the stations.
+    const auto nStations {graph.stationIds.size()};
+    if (stationA >= nStations || stationB >= nStations) {
+        return TravelRoute {};
+    }
+    const auto& stationAId {graph.stationIds[stationA]};
+    const auto& stationBId {graph.stationIds[stationB]};
+    spdlog::info("GetQuietTravelRoute: {} -> {}", stationAId, stationBId);
+
+    // Corner case: A and B are the same station.
+    if (stationA == stationB) {
+        return TravelRoute {
+            stationAId,
+            stationAId,
+            0,
+            {TravelRoute::Step {
+                stationAId,
+                stationAId,
+                {},
+                {},
+                0
+            }},
+        };
+    }
+
+    // Get the paths within a certain travel time threshold, starting with the
+    // fastest one. These are all valid candidates for the most quiet route.
+    std::vector<Path> paths {};
+    switch (search) {
+        case QuietRouteSearch::kYen:
+            paths = GetKFastestPaths(
+                graph,
+                stationA,
+                stationB,
+                maxSlowdownPc,
+                maxNPaths
+            );
+            break;
+        case QuietRouteSearch::kPareto: {
+            // We only need the fastest path and the most quiet one.
+            auto fastestPath {GetFastestPath(graph, stationA, stationB)};
+            if (fastestPath.empty()) {
+                break;
+            }
+            auto quietestPath {GetQuietestPath(
+                graph,
+                model,
+                stationA,
+                stationB,
+                static_cast<unsigned int>(
+                    fastestPath.back().second * (1 + maxSlowdownPc)
+                )
+            )};
+            paths.emplace_back(std::move(fastestPath));
+            if (!quietestPath.empty()) {
+                paths.emplace_back(std::move(quietestPath));
+            }
+            break;
+        }
+        case QuietRouteSearch::kLagrangian: {
+            // We only need the fastest path and the quiet one.
+            auto fastestPath {GetFastestPath(graph, stationA, stationB)};
+            if (fastestPath.empty()) {
+                break;
+            }
+            auto quietPath {GetLagrangianQuietestPath(
+                graph,
+                model,
+                stationA,
+                stationB,
+                static_cast<unsigned int>(
+                    fastestPath.back().second * (1 + maxSlowdownPc)
+                ),
+                fastestPath
+            )};
+            paths.emplace_back(std::move(fastestPath));
+            if (!quietPath.empty()) {
+                paths.emplace_back(std::move(quietPath));
+            }
+            break;
+        }
+    }
 
     // Corner case: There is no valid path between A and B.
     if (paths.empty()) {
@@ -573,51 +2094,278 @@ TravelRoute TransportNetwork::GetQuietTravelRoute(
     // count. If the path is not quiet "enough", we just go with the fastest
     // route.
     spdlog::info("Found {} paths", paths.size());
-    auto& mostQuietPath {paths.front()}; // Fastest path
-    unsigned int minCrowding {GetPathCrowding(paths.front())};
+    size_t mostQuietPath {0}; // Fastest path
+    unsigned int minCrowding {
+        GetPathCrowding(graph, model, paths.front())
+    };
     spdlog::info("Fastest path: {} travel time, {} crowding",
-                 mostQuietPath.back().second, minCrowding);
+                 paths.front().back().second, minCrowding);
     auto maxCrowding {static_cast<unsigned int>(
         minCrowding * (1 - minQuietnessPc)
     )};
     for (size_t idx {1}; idx < paths.size(); ++idx) {
-        auto crowding {GetPathCrowding(paths[idx])};
+        auto crowding {GetPathCrowding(graph, model, paths[idx])};
         if (crowding > maxCrowding) {
             continue;
         }
         if (crowding < minCrowding) {
             minCrowding = crowding;
-            mostQuietPath = paths[idx];
+            mostQuietPath = idx;
         }
     }
     spdlog::info("Most quiet path: {} travel time, {} crowding",
-                 mostQuietPath.back().second, minCrowding);
+                 paths[mostQuietPath].back().second, minCrowding);
 
-    // Assemble the path.
-    // Note: We go in reverse order, from B to A, because this is how the
-    //       previousStop map is structured.
-    const auto& totalTravelTime {mostQuietPath.back().second};
-    TravelRoute travelRoute {
-        stationAId,
-        stationBId,
-        totalTravelTime,
-        {},
-    };
-    travelRoute.steps.reserve(mostQuietPath.size());
-    for (size_t idx {1}; idx < mostQuietPath.size(); ++idx) {
-        const auto& prevStop {mostQuietPath[idx - 1].first};
-        const auto& currStop {mostQuietPath[idx].first};
-        travelRoute.steps.push_back(TravelRoute::Step {
-            prevStop.node->id,
-            currStop.node->id,
-            currStop.edge->route->line->id,
-            currStop.edge->route->id,
-            currStop.edge->travelTime,
-        });
+    auto travelRoute {GetTravelRoute(graph, paths[mostQuietPath])};
+    if (candidatePaths != nullptr) {
+        *candidatePaths = std::move(paths);
     }
     return travelRoute;
 }
 
+std::vector<TravelRoute> TransportNetwork::GetFastestTravelRoutes(
+    const std::vector<std::pair<Id, Id>>& queries
+) const
+{
+    std::vector<TravelRoute> travelRoutes(queries.size());
+    RunBatchQueries(queries.size(), [&](const size_t idx) {
+        travelRoutes[idx] = GetFastestTravelRoute(
+            queries[idx].first,
+            queries[idx].second
+        );
+    });
+    return travelRoutes;
+}
+
+std::vector<TravelRoute> TransportNetwork::GetFastestTravelRoutes(
+    const std::vector<std::pair<StationHandle, StationHandle>>& queries
+) const
+{
+    std::vector<TravelRoute> travelRoutes(queries.size());
+    RunBatchQueries(queries.size(), [&](const size_t idx) {
+        travelRoutes[idx] = GetFastestTravelRoute(
+            queries[idx].first,
+            queries[idx].second
+        );
+    });
+    return travelRoutes;
+}
+
+std::vector<TravelRoute> TransportNetwork::GetQuietTravelRoutes(
+    const std::vector<std::pair<Id, Id>>& queries,
+    const double maxSlowdownPc,
+    const double minQuietnessPc,
+    const size_t maxNPaths,
+    const QuietRouteSearch search,
+    const CrowdingModel model
+) const
+{
+    std::vector<TravelRoute> travelRoutes(queries.size());
+    RunBatchQueries(queries.size(), [&](const size_t idx) {
+        travelRoutes[idx] = GetQuietTravelRoute(
+            queries[idx].first,
+            queries[idx].second,
+            maxSlowdownPc,
+            minQuietnessPc,
+            maxNPaths,
+            search,
+            model
+        );
+    });
+    return travelRoutes;
+}
+
+std::vector<TravelRoute> TransportNetwork::GetQuietTravelRoutes(
+    const std::vector<std::pair<StationHandle, StationHandle>>& queries,
+    const double maxSlowdownPc,
+    const double minQuietnessPc,
+    const size_t maxNPaths,
+    const QuietRouteSearch search,
+    const CrowdingModel model
+) const
+{
+    std::vector<TravelRoute> travelRoutes(queries.size());
+    RunBatchQueries(queries.size(), [&](const size_t idx) {
+        travelRoutes[idx] = GetQuietTravelRoute(
+            queries[idx].first,
+            queries[idx].second,
+            maxSlowdownPc,
+            minQuietnessPc,
+            maxNPaths,
+            search,
+            model
+        );
+    });
+    return travelRoutes;
+}
+
+std::vector<unsigned int> TransportNetwork::GetTravelTimeMatrix(
+    const std::vector<Id>& sources,
+    const std::vector<Id>& targets
+) const
+{
+    auto lookupStations {[this](const std::vector<Id>& stations) {
+        std::vector<StationHandle> handles {};
+        handles.reserve(stations.size());
+        for (const auto& station: stations) {
+            handles.push_back(LookupStation(station));
+        }
+        return handles;
+    }};
+    return GetTravelTimeMatrix(lookupStations(sources), lookupStations(targets));
+}
+
+std::vector<unsigned int> TransportNetwork::GetTravelTimeMatrix(
+    const std::vector<StationHandle>& sources,
+    const std::vector<StationHandle>& targets
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    const auto nStations {graph.stationIds.size()};
+    std::vector<unsigned int> matrix(
+        sources.size() * targets.size(),
+        kUnreachableTravelTime
+    );
+
+    // The same station may be a target more than once.
+    std::vector<std::vector<size_t>> targetColumns(nStations);
+    size_t nTargetStations {0};
+    for (size_t column {0}; column < targets.size(); ++column) {
+        if (targets[column] >= nStations) {
+            continue;
+        }
+        auto& columns {targetColumns[targets[column]]};
+        if (columns.empty()) {
+            ++nTargetStations;
+        }
+        columns.push_back(column);
+    }
+
+    RunBatchQueries(sources.size(), [&](const size_t source) {
+        if (sources[source] >= nStations || nTargetStations == 0) {
+            return;
+        }
+        GetTravelTimesFrom(
+            graph,
+            sources[source],
+            targetColumns,
+            nTargetStations,
+            &matrix[source * targets.size()]
+        );
+    });
+    return matrix;
+}
+
+std::vector<ReachableStation> TransportNetwork::GetReachableStations(
+    const Id& station,
+    const unsigned int maxTravelTime
+) const
+{
+    return GetReachableStations(LookupStation(station), maxTravelTime);
+}
+
+std::vector<ReachableStation> TransportNetwork::GetReachableStations(
+    const StationHandle station,
+    const unsigned int maxTravelTime
+) const
+{
+    const auto graphSnapshot {LoadGraph()};
+    const auto& graph {*graphSnapshot};
+    if (station >= graph.stationIds.size()) {
+        return {};
+    }
+
+    // Supporting data structures for Dijkstra's algorithm.
+    // They all live in the thread workspace:
+    // - Travel time and route changes of any state from the start station.
+    // - Whether we already reached a station, by station.
+    // - The priority queue of states to visit, by travel time, then route
+    //   changes.
+    auto& workspace {GetSearchWorkspace()};
+    workspace.Reset(
+        graph.stateStations.size(),
+        graph.edges.size(),
+        graph.stationIds.size()
+    );
+    const auto generation {workspace.generation};
+    auto& seen {workspace.seen};
+    auto& settled {workspace.settled};
+    auto& distFromA {workspace.distFromA};
+    auto& nRouteChanges {workspace.nRouteChanges};
+    auto& stationReached {workspace.stationReached};
+    auto& statesToReach {workspace.statesToReach};
+    statesToReach.clear();
+    using ReachRank = std::tuple<unsigned int, unsigned int, std::uint32_t>;
+
+    const auto stateA {
+        static_cast<std::uint32_t>(graph.nRouteStates + station)
+    };
+    seen[stateA] = generation;
+    distFromA[stateA] = 0;
+    nRouteChanges[stateA] = 0;
+    statesToReach.push_back({0, 0, stateA});
+
+    std::vector<ReachableStation> reachableStations {};
+    while (!statesToReach.empty()) {
+        std::pop_heap(statesToReach.begin(), statesToReach.end(),
+                      std::greater<ReachRank> {});
+        const auto [currDist, currRouteChanges, currState] =
+            statesToReach.back();
+        statesToReach.pop_back();
+        if (settled[currState] == generation) {
+            continue;
+        }
+        settled[currState] = generation;
+
+        // The first time we settle a state at a station, we got there with
+        // the fastest route, and with the fewest route changes among those.
+        const auto currStation {graph.stateStations[currState]};
+        if (stationReached[currStation] != generation) {
+            stationReached[currStation] = generation;
+            reachableStations.push_back({
+                graph.stationIds[currStation],
+                currDist,
+                currRouteChanges,
+            });
+        }
+
+        const auto arcsEnd {graph.stateArcOffsets[currState + 1]};
+        for (auto idx {graph.stateArcOffsets[currState]}; idx < arcsEnd;
+             ++idx) {
+            const auto& arc {graph.stateArcs[idx]};
+            const auto& nextState {arc.nextState};
+
+            // We stop at the edge of the budget.
+            const auto nextDist {currDist + arc.travelTime};
+            if (nextDist > maxTravelTime) {
+                continue;
+            }
+
+            // Transfer arcs from a route state change route. The transfer
+            // arcs from the departure state only board the first route.
+            const auto nextRouteChanges {
+                currRouteChanges +
+                    (arc.edge == kNoEdge && currState < graph.nRouteStates ?
+                     1 : 0)
+            };
+            if (seen[nextState] != generation ||
+                nextDist < distFromA[nextState] ||
+                (nextDist == distFromA[nextState] &&
+                 nextRouteChanges < nRouteChanges[nextState])) {
+                seen[nextState] = generation;
+                distFromA[nextState] = nextDist;
+                nRouteChanges[nextState] = nextRouteChanges;
+                statesToReach.push_back({nextDist, nextRouteChanges, nextState});
+                std::push_heap(statesToReach.begin(), statesToReach.end(),
+                               std::greater<ReachRank> {});
+            }
+        }
+    }
+
+    return reachableStations;
+}
+
 // TransportNetwork — Private methods
 
 std::vector<
@@ -642,22 +2390,300 @@ bool TransportNetwork::PathStop::operator==(
     return node == other.node && edge == other.edge;
 }
 
-size_t TransportNetwork::PathStopHash::operator()(
-    const TransportNetwork::PathStop& stop
+bool TransportNetwork::RouteCacheKey::operator==(
+    const TransportNetwork::RouteCacheKey& other
 ) const
 {
-    size_t seed {0};
-    boost::hash_combine(seed, stop.node ? stop.node->id : "");
-    boost::hash_combine(seed, stop.edge ? stop.edge->route->id : "");
-    return seed;
+    return std::tie(
+        quiet,
+        stationA,
+        stationB,
+        maxSlowdownPc,
+        minQuietnessPc,
+        maxNPaths,
+        search,
+        model
+    ) == std::tie(
+        other.quiet,
+        other.stationA,
+        other.stationB,
+        other.maxSlowdownPc,
+        other.minQuietnessPc,
+        other.maxNPaths,
+        other.search,
+        other.model
+    );
 }
 
-bool TransportNetwork::PathStopDistCmp::operator()(
-    const TransportNetwork::PathStopDist& a,
-    const TransportNetwork::PathStopDist& b
+size_t TransportNetwork::RouteCacheKeyHash::operator()(
+    const TransportNetwork::RouteCacheKey& key
 ) const
 {
-    return a.second > b.second;
+    // Combine the hashes of all key fields.
+    size_t hash {std::hash<bool> {}(key.quiet)};
+    const auto combine {[&hash](const size_t fieldHash) {
+        hash ^= fieldHash + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }};
+    combine(std::hash<StationHandle> {}(key.stationA));
+    combine(std::hash<StationHandle> {}(key.stationB));
+    combine(std::hash<double> {}(key.maxSlowdownPc));
+    combine(std::hash<double> {}(key.minQuietnessPc));
+    combine(std::hash<size_t> {}(key.maxNPaths));
+    combine(std::hash<int> {}(static_cast<int>(key.search)));
+    combine(std::hash<int> {}(static_cast<int>(key.model)));
+    return hash;
+}
+
+TransportNetwork::PassengerCounts::PassengerCounts(
+    const PassengerCounts& copied,
+    const size_t nStations,
+    const size_t nRouteStops
+) : stationCounters_ {copied.stationCounters_, nStations},
+    routeStopCounters_ {copied.routeStopCounters_, nRouteStops}
+{
+    latestTime_.store(copied.GetLatestTime(), std::memory_order_relaxed);
+    halfLife_.store(
+        copied.halfLife_.load(std::memory_order_relaxed),
+        std::memory_order_relaxed
+    );
+    epoch_.store(copied.GetEpoch(), std::memory_order_relaxed);
+}
+
+size_t TransportNetwork::PassengerCounts::GetNStations() const
+{
+    return stationCounters_.size;
+}
+
+size_t TransportNetwork::PassengerCounts::GetNRouteStops() const
+{
+    return routeStopCounters_.size;
+}
+
+void TransportNetwork::PassengerCounts::Add(
+    const std::uint32_t station,
+    const long long int nPassengers,
+    const std::uint32_t time
+)
+{
+    AddTo(stationCounters_, station, nPassengers, time);
+}
+
+void TransportNetwork::PassengerCounts::AddAtRouteStop(
+    const std::uint32_t routeStop,
+    const long long int nPassengers,
+    const std::uint32_t time
+)
+{
+    AddTo(routeStopCounters_, routeStop, nPassengers, time);
+}
+
+long long int TransportNetwork::PassengerCounts::Get(
+    const std::uint32_t station
+) const
+{
+    return stationCounters_.GetCount(station).load(std::memory_order_relaxed);
+}
+
+long long int TransportNetwork::PassengerCounts::GetAtRouteStop(
+    const std::uint32_t routeStop
+) const
+{
+    return routeStopCounters_.GetCount(routeStop).load(
+        std::memory_order_relaxed
+    );
+}
+
+double TransportNetwork::PassengerCounts::GetDecayed(
+    const std::uint32_t station
+) const
+{
+    return GetDecayedFrom(stationCounters_, station);
+}
+
+double TransportNetwork::PassengerCounts::GetDecayedAtRouteStop(
+    const std::uint32_t routeStop
+) const
+{
+    return GetDecayedFrom(routeStopCounters_, routeStop);
+}
+
+std::uint32_t TransportNetwork::PassengerCounts::GetLatestTime() const
+{
+    return latestTime_.load(std::memory_order_relaxed);
+}
+
+void TransportNetwork::PassengerCounts::SetHalfLife(
+    const double halfLife
+)
+{
+    halfLife_.store(halfLife, std::memory_order_relaxed);
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::uint64_t TransportNetwork::PassengerCounts::GetEpoch() const
+{
+    return epoch_.load(std::memory_order_relaxed);
+}
+
+double TransportNetwork::PassengerCounts::GetDecay(
+    const std::uint32_t elapsed
+) const
+{
+    return std::exp2(
+        -static_cast<double>(elapsed) /
+            halfLife_.load(std::memory_order_relaxed)
+    );
+}
+
+void TransportNetwork::PassengerCounts::AddTo(
+    Counters& counters,
+    const std::uint32_t idx,
+    const long long int nPassengers,
+    const std::uint32_t time
+)
+{
+    counters.GetCount(idx).fetch_add(nPassengers, std::memory_order_relaxed);
+
+    // Move the latest event time forward.
+    auto latestTime {latestTime_.load(std::memory_order_relaxed)};
+    while (latestTime < time &&
+           !latestTime_.compare_exchange_weak(latestTime, time,
+                                              std::memory_order_relaxed)) {
+    }
+
+    // Decay the count to the later of the event time and its last update,
+    // then add the event. Events that arrive late are decayed instead.
+    auto& decayedCount {counters.GetDecayedCount(idx)};
+    auto packed {decayedCount.load(std::memory_order_relaxed)};
+    std::uint64_t newPacked {0};
+    do {
+        const auto [value, valueTime] = UnpackDecayedCount(packed);
+        if (time >= valueTime) {
+            newPacked = PackDecayedCount(
+                value * GetDecay(time - valueTime) + nPassengers,
+                time
+            );
+        } else {
+            newPacked = PackDecayedCount(
+                value + nPassengers * GetDecay(valueTime - time),
+                valueTime
+            );
+        }
+    } while (!decayedCount.compare_exchange_weak(packed, newPacked,
+                                                 std::memory_order_relaxed));
+
+    epoch_.fetch_add(1, std::memory_order_relaxed);
+}
+
+double TransportNetwork::PassengerCounts::GetDecayedFrom(
+    const Counters& counters,
+    const std::uint32_t idx
+) const
+{
+    const auto [value, valueTime] = UnpackDecayedCount(
+        counters.GetDecayedCount(idx).load(std::memory_order_relaxed)
+    );
+    const auto latestTime {GetLatestTime()};
+    return latestTime > valueTime ? value * GetDecay(latestTime - valueTime) :
+                                    value;
+}
+
+TransportNetwork::PassengerCounts::Counters::Counters(
+    const Counters& copied,
+    const size_t nItems
+) : size {nItems},
+    counts((nItems + Block<long long int>::kSize - 1) /
+           Block<long long int>::kSize),
+    decayedCounts((nItems + Block<std::uint64_t>::kSize - 1) /
+                  Block<std::uint64_t>::kSize)
+{
+    for (std::uint32_t idx {0}; idx < copied.size; ++idx) {
+        GetCount(idx).store(
+            copied.GetCount(idx).load(std::memory_order_relaxed),
+            std::memory_order_relaxed
+        );
+        GetDecayedCount(idx).store(
+            copied.GetDecayedCount(idx).load(std::memory_order_relaxed),
+            std::memory_order_relaxed
+        );
+    }
+}
+
+std::atomic<long long int>&
+TransportNetwork::PassengerCounts::Counters::GetCount(
+    const std::uint32_t idx
+)
+{
+    return counts[idx / Block<long long int>::kSize]
+        .counters[idx % Block<long long int>::kSize];
+}
+
+const std::atomic<long long int>&
+TransportNetwork::PassengerCounts::Counters::GetCount(
+    const std::uint32_t idx
+) const
+{
+    return counts[idx / Block<long long int>::kSize]
+        .counters[idx % Block<long long int>::kSize];
+}
+
+std::atomic<std::uint64_t>&
+TransportNetwork::PassengerCounts::Counters::GetDecayedCount(
+    const std::uint32_t idx
+)
+{
+    return decayedCounts[idx / Block<std::uint64_t>::kSize]
+        .counters[idx % Block<std::uint64_t>::kSize];
+}
+
+const std::atomic<std::uint64_t>&
+TransportNetwork::PassengerCounts::Counters::GetDecayedCount(
+    const std::uint32_t idx
+) const
+{
+    return decayedCounts[idx / Block<std::uint64_t>::kSize]
+        .counters[idx % Block<std::uint64_t>::kSize];
+}
+
+void TransportNetwork::SearchWorkspace::Reset(
+    const size_t nStates,
+    const size_t nEdges,
+    const size_t nStations
+)
+{
+    // The arrays only grow, so that we can reuse the workspace across networks
+    // of different sizes.
+    if (seen.size() < nStates) {
+        seen.resize(nStates, 0);
+        settled.resize(nStates, 0);
+        distFromA.resize(nStates, 0);
+        minCrowding.resize(nStates, 0);
+        costFromA.resize(nStates, 0.0);
+        nRouteChanges.resize(nStates, 0);
+        previousState.resize(nStates, 0);
+        lastEdge.resize(nStates, kNoEdge);
+    }
+    if (excluded.size() < nEdges) {
+        excluded.resize(nEdges, 0);
+    }
+    if (lowerBoundSeen.size() < nStations) {
+        lowerBoundSeen.resize(nStations, 0);
+        lowerBound.resize(nStations, 0);
+        stationReached.resize(nStations, 0);
+    }
+    nodesToVisit.clear();
+
+    // On the (very) rare generation counter overflow, we need to clear the old
+    // records for real.
+    ++generation;
+    if (generation == 0) {
+        std::fill(seen.begin(), seen.end(), 0);
+        std::fill(settled.begin(), settled.end(), 0);
+        std::fill(excluded.begin(), excluded.end(), 0);
+        std::fill(lowerBoundSeen.begin(), lowerBoundSeen.end(), 0);
+        std::fill(stationReached.begin(), stationReached.end(), 0);
+        generation = 1;
+    }
 }
 
 bool TransportNetwork::PathCmp::operator()(
@@ -665,7 +2691,27 @@ bool TransportNetwork::PathCmp::operator()(
     const TransportNetwork::Path& b
 ) const
 {
-    return a.back().second > b.back().second;
+    if (a.back().second != b.back().second) {
+        return a.back().second > b.back().second;
+    }
+
+    // Equally fast paths are sorted by their edges, so that the order in which
+    // we extract them does not depend on the order in which we found them.
+    return std::lexicographical_compare(
+        a.begin(), a.end(),
+        b.begin(), b.end(),
+        [](const auto& stopA, const auto& stopB) {
+            return stopA.first.edge < stopB.first.edge;
+        }
+    );
+}
+
+bool TransportNetwork::StateDistCmp::operator()(
+    const TransportNetwork::StateDist& a,
+    const TransportNetwork::StateDist& b
+) const
+{
+    return a.second > b.second;
 }
 
 std::shared_ptr<TransportNetwork::GraphNode> TransportNetwork::GetStation(
@@ -707,6 +2753,66 @@ std::shared_ptr<TransportNetwork::RouteInternal> TransportNetwork::GetRoute(
     return routeIt->second;
 }
 
+bool TransportNetwork::AddStationToNetwork(
+    const Station& station
+)
+{
+    // Cannot add a station that is already in the network.
+    if (GetStation(station.id) != nullptr) {
+        return false;
+    }
+
+    // Create a new station node and add it to the map.
+    auto node {std::make_shared<GraphNode>(GraphNode {
+        station.id,
+        station.name,
+        {}, // We start with no edges.
+        {}, // We start with no routes.
+        static_cast<std::uint32_t>(stationNodes_.size()),
+    })};
+    stationNodes_.push_back(node);
+    stations_.emplace(station.id, std::move(node));
+
+    return true;
+}
+
+bool TransportNetwork::AddLineToNetwork(
+    const Line& line
+)
+{
+    // Cannot add a line that is already in the network.
+    if (GetLine(line.id) != nullptr) {
+        return false;
+    }
+
+    // Create the internal version of the line.
+    auto lineInternal {std::make_shared<LineInternal>(LineInternal {
+        line.id,
+        line.name,
+        {}, // We will add routes shortly.
+        static_cast<std::uint32_t>(lineNodes_.size()),
+    })};
+
+    // Add the routes to the line.
+    for (const auto& route: line.routes) {
+        bool ok {AddRouteToLine(route, lineInternal)};
+        if (!ok) {
+            return false;
+        }
+    }
+
+    // Only add the line and its routes to the network when we are sure that
+    // there were no errors, so that a bad line leaves no trace. We add the
+    // routes in the order of the line, which sets their handles.
+    lineNodes_.push_back(lineInternal);
+    for (const auto& route: line.routes) {
+        AddRouteToNetwork(lineInternal->routes.at(route.id));
+    }
+    lines_.emplace(line.id, std::move(lineInternal));
+
+    return true;
+}
+
 bool TransportNetwork::AddRouteToLine(
     const Route& route,
     const std::shared_ptr<LineInternal>& lineInternal
@@ -729,170 +2835,1015 @@ bool TransportNetwork::AddRouteToLine(
         stops.push_back(station);
     }
 
-    // Create the route.
-    auto routeInternal {std::make_shared<RouteInternal>(RouteInternal {
-        route.id,
-        lineInternal,
-        std::move(stops)
-    })};
-
-    // Walk the station nodes to add an edge for the route.
-    for (size_t idx {0}; idx < routeInternal->stops.size() - 1; ++idx) {
-        const auto& thisStop {routeInternal->stops[idx]};
-        const auto& nextStop {routeInternal->stops[idx + 1]};
-        thisStop->edges.emplace_back(std::make_shared<GraphEdge>(GraphEdge {
-            routeInternal,
-            nextStop,
-            0,
-        }));
+    // Create the route. It gets its handle when we add it to the network.
+    lineInternal->routes[route.id] = std::make_shared<RouteInternal>(
+        RouteInternal {
+            route.id,
+            lineInternal,
+            std::move(stops),
+        }
+    );
+
+    return true;
+}
+
+void TransportNetwork::AddRouteToNetwork(
+    const std::shared_ptr<RouteInternal>& routeInternal
+)
+{
+    routeInternal->index = static_cast<std::uint32_t>(routeNodes_.size());
+    routeNodes_.push_back(routeInternal);
+
+    // Walk the station nodes to add an edge for the route.
+    for (size_t idx {0}; idx < routeInternal->stops.size() - 1; ++idx) {
+        const auto& thisStop {routeInternal->stops[idx]};
+        const auto& nextStop {routeInternal->stops[idx + 1]};
+        thisStop->edges.emplace_back(std::make_shared<GraphEdge>(GraphEdge {
+            routeInternal,
+            nextStop,
+            0,
+        }));
+    }
+
+    // Keep track of the routes serving each station. A route may stop at the
+    // same station more than once.
+    for (const auto& stop: routeInternal->stops) {
+        auto& stopRoutes {stop->routes};
+        if (std::find(stopRoutes.begin(), stopRoutes.end(),
+                      routeInternal->index) == stopRoutes.end()) {
+            stopRoutes.push_back(routeInternal->index);
+        }
+    }
+}
+
+void TransportNetwork::BuildGraph()
+{
+    Graph graph {};
+    BuildGraphTables(graph);
+    BuildStateGraph(graph, routeChangePenalty_);
+    BuildLandmarks(graph);
+    graph.goalDirectedSearch = goalDirectedSearch_;
+    graph.quietRouteCrowdingTolerancePc = quietRouteCrowdingTolerancePc_;
+    graph.withAllPairs = precomputeFastestTravelRoutes_;
+    graph.withContractionHierarchy = precomputeContractionHierarchy_;
+
+    PublishGraph(std::move(graph));
+}
+
+void TransportNetwork::BuildGraphTables(
+    Graph& graph
+) const
+{
+    graph.edgeOffsets.reserve(stationNodes_.size() + 1);
+    graph.stationHandles.reserve(stationNodes_.size());
+    graph.stationIds.reserve(stationNodes_.size());
+    for (const auto& station: stationNodes_) {
+        for (const auto& edge: station->edges) {
+            graph.edges.push_back(Graph::Edge {
+                edge->nextStop->index,
+                edge->route->index,
+                edge->travelTime,
+            });
+        }
+        graph.edgeOffsets.push_back(
+            static_cast<std::uint32_t>(graph.edges.size())
+        );
+        graph.stationHandles.emplace(station->id, station->index);
+        graph.stationIds.push_back(station->id);
+        graph.stationRoutes.push_back(station->routes);
+    }
+
+    graph.lineIds.reserve(lineNodes_.size());
+    graph.lineHandles.reserve(lineNodes_.size());
+    for (const auto& line: lineNodes_) {
+        graph.lineIds.push_back(line->id);
+        graph.lineHandles.emplace(line->id, line->index);
+    }
+
+    graph.routeLines.reserve(routeNodes_.size());
+    graph.routeIds.reserve(routeNodes_.size());
+    graph.routeHandles.reserve(routeNodes_.size());
+    graph.routeStopOffsets.reserve(routeNodes_.size() + 1);
+    for (const auto& route: routeNodes_) {
+        graph.routeLines.push_back(route->line->index);
+        graph.routeIds.push_back(route->id);
+        graph.routeHandles.emplace(route->id, route->index);
+        auto routeStop {graph.routeStopOffsets.back()};
+        unsigned int travelTime {0};
+        for (const auto& stop: route->stops) {
+            graph.routeStops.emplace(
+                static_cast<std::uint64_t>(route->index) << 32 | stop->index,
+                routeStop++
+            );
+            graph.routeStopTravelTimes.push_back(travelTime);
+
+            // Like GetRouteStop, we use the first stop at each station, and
+            // so the first edge of the stop for this route.
+            const auto edgeIt {stop->FindEdgeForRoute(route)};
+            if (edgeIt != stop->edges.end()) {
+                travelTime += (*edgeIt)->travelTime;
+            }
+        }
+        graph.routeStopOffsets.push_back(routeStop);
+    }
+
+    // Keep the passenger counts, with room for any new stations or routes.
+    const auto previousGraph {LoadGraph()};
+    const auto& previousCounts {*previousGraph->passengerCounts};
+    const auto nRouteStops {graph.routeStopOffsets.back()};
+    if (previousCounts.GetNStations() >= stationNodes_.size() &&
+        previousCounts.GetNRouteStops() >= nRouteStops) {
+        graph.passengerCounts = previousGraph->passengerCounts;
+    } else {
+        graph.passengerCounts = std::make_shared<PassengerCounts>(
+            previousCounts,
+            stationNodes_.size(),
+            nRouteStops
+        );
+    }
+}
+
+void TransportNetwork::ClearNetwork()
+{
+    stations_.clear();
+    lines_.clear();
+    stationNodes_.clear();
+    lineNodes_.clear();
+    routeNodes_.clear();
+}
+
+std::shared_ptr<const TransportNetwork::Graph>
+TransportNetwork::LoadGraph() const
+{
+    return std::atomic_load(&graph_);
+}
+
+void TransportNetwork::PublishGraph(
+    Graph&& graph
+)
+{
+    graph.version = ++graphVersion_;
+    std::atomic_store(
+        &graph_,
+        std::shared_ptr<const Graph>(std::make_shared<Graph>(std::move(graph)))
+    );
+
+    // All cached routes may be outdated. Queries that were still running on
+    // the previous graph cannot add them back, as they have a different graph
+    // version.
+    routeCache_.Clear();
+}
+
+void TransportNetwork::BuildFastestTravelRoutes(
+    const Graph& graph,
+    GraphIndexes& indexes
+) const
+{
+    const auto nStations {graph.stationIds.size()};
+    const auto nStates {graph.stateStations.size()};
+    std::vector<unsigned int> distFromA(nStations * nStates, kUnreachable);
+    std::vector<std::uint32_t> previousState(nStations * nStates, 0);
+    std::vector<std::uint32_t> lastState(nStations * nStations, kNoEdge);
+
+    // Each origin station writes to its own slice of the tables, so we can
+    // process them in parallel.
+    auto buildFromStation {[&](const std::uint32_t stationA) {
+        // A search with no destination explores the whole network and leaves
+        // its search tree in the thread workspace.
+        GetFastestTravelRoute(
+            graph,
+            {{stationA, kNoEdge}, 0},
+            kInvalidStationHandle
+        );
+        const auto& workspace {GetSearchWorkspace()};
+        auto* dist {&distFromA[stationA * nStates]};
+        auto* previous {&previousState[stationA * nStates]};
+        auto* last {&lastState[stationA * nStations]};
+        std::vector<std::uint32_t> lastEdges(nStations, kNoEdge);
+        for (size_t state {0}; state < nStates; ++state) {
+            if (workspace.seen[state] != workspace.generation) {
+                continue;
+            }
+            dist[state] = workspace.distFromA[state];
+            previous[state] = workspace.previousState[state];
+
+            // Same tie-breaking rule as the search: Among the fastest ways to
+            // get to a station, we pick the one with the highest last edge
+            // index.
+            const auto station {graph.stateStations[state]};
+            const auto lastEdge {workspace.lastEdge[state]};
+            auto& lastStateAtStation {last[station]};
+            if (lastStateAtStation == kNoEdge ||
+                dist[state] < dist[lastStateAtStation] ||
+                (dist[state] == dist[lastStateAtStation] &&
+                 lastEdge > lastEdges[station])) {
+                lastStateAtStation = static_cast<std::uint32_t>(state);
+                lastEdges[station] = lastEdge;
+            }
+        }
+    }};
+    // We reuse the batch query pool, rather than start threads on every
+    // rebuild.
+    RunTasks(GetBatchQueryPool(), nStations, [&buildFromStation](
+        const size_t stationA
+    ) {
+        buildFromStation(static_cast<std::uint32_t>(stationA));
+    });
+
+    indexes.allPairsDistFromA = std::move(distFromA);
+    indexes.allPairsPreviousState = std::move(previousState);
+    indexes.allPairsLastState = std::move(lastState);
+}
+
+const TransportNetwork::GraphIndexes& TransportNetwork::GetGraphIndexes(
+    const Graph& graph,
+    const bool wait
+) const
+{
+    auto& indexes {*graph.indexes};
+    const auto isBuilt {[&graph, &indexes]() {
+        return (!graph.withAllPairs || indexes.hasAllPairs) &&
+            (!graph.withContractionHierarchy ||
+             indexes.hasContractionHierarchy);
+    }};
+    if (isBuilt()) {
+        return indexes;
+    }
+
+    // There is no point in building the indexes of a graph that a change
+    // already replaced.
+    std::unique_lock<std::mutex> lock {indexes.buildMutex, std::defer_lock};
+    if (wait) {
+        lock.lock();
+    } else if (LoadGraph()->indexes != graph.indexes || !lock.try_lock()) {
+        return indexes;
+    }
+    if (graph.withAllPairs && !indexes.hasAllPairs) {
+        BuildFastestTravelRoutes(graph, indexes);
+        indexes.hasAllPairs = true;
+    }
+    if (graph.withContractionHierarchy && !indexes.hasContractionHierarchy) {
+        BuildContractionHierarchy(graph, indexes);
+        indexes.hasContractionHierarchy = true;
+    }
+    return indexes;
+}
+
+void TransportNetwork::BuildContractionHierarchy(
+    const Graph& graph,
+    GraphIndexes& indexes
+) const
+{
+    const auto nStations {graph.stationIds.size()};
+    const auto nStates {graph.stateStations.size()};
+
+    // The index covers the route-expanded graph, plus an arc from each route
+    // state to the arrival node of its station.
+    // Stations served by many routes have many transfer arcs between them,
+    // which slow down the contraction. We replace them with a transfer through
+    // the departure state of the station, which has the same travel time.
+    std::vector<ContractionHierarchy::Arc> arcs {};
+    arcs.reserve(graph.edges.size() + 3 * graph.nRouteStates);
+    for (std::uint32_t state {0}; state < nStates; ++state) {
+        const auto arcsEnd {graph.stateArcOffsets[state + 1]};
+        for (auto idx {graph.stateArcOffsets[state]}; idx < arcsEnd; ++idx) {
+            const auto& arc {graph.stateArcs[idx]};
+            if (state < graph.nRouteStates && arc.edge == kNoEdge) {
+                continue;
+            }
+            arcs.push_back({state, arc.nextState, arc.travelTime});
+        }
+        if (state < graph.nRouteStates) {
+            const auto station {graph.stateStations[state]};
+            arcs.push_back({
+                state,
+                static_cast<std::uint32_t>(graph.nRouteStates + station),
+                graph.routeChangePenalty,
+            });
+            arcs.push_back({
+                state,
+                static_cast<std::uint32_t>(nStates + station),
+                0,
+            });
+        }
+    }
+    indexes.contractionHierarchy = ContractionHierarchy(
+        nStates + nStations,
+        arcs
+    );
+}
+
+void TransportNetwork::BuildStateGraph(
+    Graph& graph,
+    const unsigned int routeChangePenalty
+)
+{
+    const auto nStations {graph.stationIds.size()};
+    const auto nRoutes {graph.routeIds.size()};
+    graph.routeChangePenalty = routeChangePenalty;
+
+    // We create a route state for each station served by a route, in the order
+    // in which we first find them along the edges.
+    std::unordered_map<std::uint64_t, std::uint32_t> routeStates {};
+    std::vector<std::vector<std::uint32_t>> stationRouteStates(nStations);
+    auto getRouteState {[&](
+        const std::uint32_t station,
+        const std::uint32_t route
+    ) {
+        const auto [it, added] = routeStates.emplace(
+            static_cast<std::uint64_t>(station) * nRoutes + route,
+            static_cast<std::uint32_t>(graph.stateStations.size())
+        );
+        if (added) {
+            graph.stateStations.push_back(station);
+            graph.stateRouteStops.push_back(
+                GetRouteStop(graph, station, route)
+            );
+            stationRouteStates[station].push_back(it->second);
+        }
+        return it->second;
+    }};
+    std::vector<std::vector<Graph::StateArc>> arcsByState {};
+    for (std::uint32_t station {0}; station < nStations; ++station) {
+        const auto edgesEnd {graph.edgeOffsets[station + 1]};
+        for (auto edge {graph.edgeOffsets[station]}; edge < edgesEnd;
+             ++edge) {
+            const auto& [nextStop, route, travelTime] = graph.edges[edge];
+            const auto state {getRouteState(station, route)};
+            const auto nextState {getRouteState(nextStop, route)};
+            arcsByState.resize(graph.stateStations.size());
+            arcsByState[state].push_back({nextState, travelTime, edge});
+            graph.edgeStates.push_back(nextState);
+        }
+    }
+    graph.nRouteStates = graph.stateStations.size();
+
+    // Departure states come after all route states.
+    for (std::uint32_t station {0}; station < nStations; ++station) {
+        graph.stateStations.push_back(station);
+    }
+    arcsByState.resize(graph.stateStations.size());
+
+    // Transfer arcs
+    for (std::uint32_t station {0}; station < nStations; ++station) {
+        const auto departureState {graph.nRouteStates + station};
+        for (const auto& state: stationRouteStates[station]) {
+            arcsByState[departureState].push_back({state, 0, kNoEdge});
+            for (const auto& otherState: stationRouteStates[station]) {
+                if (otherState != state) {
+                    arcsByState[state].push_back({
+                        otherState,
+                        routeChangePenalty,
+                        kNoEdge,
+                    });
+                }
+            }
+        }
+    }
+
+    graph.stateArcOffsets.reserve(arcsByState.size() + 1);
+    for (const auto& arcs: arcsByState) {
+        graph.stateArcs.insert(graph.stateArcs.end(), arcs.begin(), arcs.end());
+        graph.stateArcOffsets.push_back(
+            static_cast<std::uint32_t>(graph.stateArcs.size())
+        );
+    }
+}
+
+void TransportNetwork::BuildLandmarks(
+    Graph& graph
+)
+{
+    const auto nStations {graph.stationIds.size()};
+    const auto nLandmarks {std::min(kNLandmarks, nStations)};
+    graph.landmarks.clear();
+    graph.landmarkDistFrom.assign(nStations * nLandmarks, kUnreachable);
+    graph.landmarkDistTo.assign(nStations * nLandmarks, kUnreachable);
+    if (nLandmarks == 0) {
+        return;
+    }
+
+    // We calculate the landmark distances on the station graph, forwards and
+    // backwards. We ignore route changes, which can only make a path slower.
+    StationAdjacency forward(nStations);
+    StationAdjacency backward(nStations);
+    for (std::uint32_t station {0}; station < nStations; ++station) {
+        const auto edgesEnd {graph.edgeOffsets[station + 1]};
+        for (auto edge {graph.edgeOffsets[station]}; edge < edgesEnd; ++edge) {
+            const auto& [nextStop, _, travelTime] = graph.edges[edge];
+            forward[station].push_back({nextStop, travelTime});
+            backward[nextStop].push_back({station, travelTime});
+        }
+    }
+
+    // We pick the landmarks one at a time, each as far as possible from the
+    // ones we already have. Stations no landmark can reach come first. This
+    // gives us landmarks at the edges of the network, where their bounds are
+    // the tightest.
+    std::vector<unsigned int> distFromLandmarks {
+        GetStationDistances(forward, 0)
+    };
+    std::vector<bool> isLandmark(nStations, false);
+    for (size_t idx {0}; idx < nLandmarks; ++idx) {
+        std::uint32_t landmark {0};
+        bool found {false};
+        for (std::uint32_t station {0}; station < nStations; ++station) {
+            if (!isLandmark[station] &&
+                (!found ||
+                 distFromLandmarks[station] > distFromLandmarks[landmark])) {
+                landmark = station;
+                found = true;
+            }
+        }
+        isLandmark[landmark] = true;
+        graph.landmarks.push_back(landmark);
+
+        const auto distFrom {GetStationDistances(forward, landmark)};
+        const auto distTo {GetStationDistances(backward, landmark)};
+        for (size_t station {0}; station < nStations; ++station) {
+            graph.landmarkDistFrom[station * nLandmarks + idx] =
+                distFrom[station];
+            graph.landmarkDistTo[station * nLandmarks + idx] = distTo[station];
+
+            // The first distances we used were from station 0, which is not
+            // necessarily a landmark.
+            distFromLandmarks[station] = idx == 0 ?
+                distFrom[station] :
+                std::min(distFromLandmarks[station], distFrom[station]);
+        }
+    }
+}
+
+unsigned int TransportNetwork::GetTravelTimeLowerBound(
+    const Graph& graph,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB
+) const
+{
+    const auto nLandmarks {graph.landmarks.size()};
+    const auto* distFromA {&graph.landmarkDistFrom[stationA * nLandmarks]};
+    const auto* distFromB {&graph.landmarkDistFrom[stationB * nLandmarks]};
+    const auto* distToA {&graph.landmarkDistTo[stationA * nLandmarks]};
+    const auto* distToB {&graph.landmarkDistTo[stationB * nLandmarks]};
+
+    // For each landmark L, the triangle inequality gives us:
+    // - d(L, B) <= d(L, A) + d(A, B)
+    // - d(A, L) <= d(A, B) + d(B, L)
+    // We skip the landmarks that cannot reach or be reached by A or B, as they
+    // tell us nothing.
+    unsigned int lowerBound {0};
+    for (size_t idx {0}; idx < nLandmarks; ++idx) {
+        if (distFromA[idx] != kUnreachable &&
+            distFromB[idx] != kUnreachable &&
+            distFromB[idx] > distFromA[idx]) {
+            lowerBound = std::max(lowerBound, distFromB[idx] - distFromA[idx]);
+        }
+        if (distToA[idx] != kUnreachable &&
+            distToB[idx] != kUnreachable &&
+            distToA[idx] > distToB[idx]) {
+            lowerBound = std::max(lowerBound, distToA[idx] - distToB[idx]);
+        }
+    }
+    return lowerBound;
+}
+
+std::uint32_t TransportNetwork::GetStopState(
+    const Graph& graph,
+    const PathStop& stop
+) const
+{
+    if (stop.edge == kNoEdge) {
+        return static_cast<std::uint32_t>(graph.nRouteStates + stop.node);
+    }
+
+    return graph.edgeStates[stop.edge];
+}
+
+const TransportNetwork::Graph::StateArc* TransportNetwork::GetRideArc(
+    const Graph& graph,
+    const std::uint32_t state,
+    const std::uint32_t nextState
+) const
+{
+    const auto arcsEnd {graph.stateArcOffsets[state + 1]};
+    for (auto idx {graph.stateArcOffsets[state]}; idx < arcsEnd; ++idx) {
+        const auto& arc {graph.stateArcs[idx]};
+        if (arc.nextState == nextState && arc.edge != kNoEdge) {
+            return &arc;
+        }
+    }
+    return nullptr;
+}
+
+bool TransportNetwork::IsSearchTreeAncestor(
+    const std::uint32_t ancestor,
+    const std::uint32_t state,
+    const std::uint32_t stateA,
+    const std::uint32_t* previousState
+) const
+{
+    auto currState {state};
+    while (currState != stateA) {
+        if (currState == ancestor) {
+            return true;
+        }
+        currState = previousState[currState];
+    }
+    return currState == ancestor;
+}
+
+TransportNetwork::Path TransportNetwork::GetSearchTreePath(
+    const Graph& graph,
+    const PathStopDist& stopA,
+    const std::uint32_t stateA,
+    const std::uint32_t stateB,
+    const unsigned int* distFromA,
+    const std::uint32_t* previousState
+) const
+{
+    Path path {};
+    auto state {stateB};
+    while (state != stateA) {
+        const auto prevState {previousState[state]};
+        const auto* arc {GetRideArc(graph, prevState, state)};
+        if (arc != nullptr) {
+            path.push_back({
+                {graph.stateStations[state], arc->edge},
+                distFromA[state]
+            });
+        }
+        state = prevState;
+    }
+    path.push_back(stopA);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+void TransportNetwork::RunTasks(
+    boost::asio::thread_pool* pool,
+    const size_t nTasks,
+    const std::function<void(size_t)>& task
+)
+{
+    // A pool thread that waits for tasks on its own pool could wait forever.
+    if (pool == nullptr || pool->get_executor().running_in_this_thread()) {
+        for (size_t idx {0}; idx < nTasks; ++idx) {
+            task(idx);
+        }
+        return;
+    }
+
+    std::mutex mutex {};
+    std::condition_variable allDone {};
+    size_t nPending {nTasks};
+    for (size_t idx {0}; idx < nTasks; ++idx) {
+        boost::asio::post(*pool, [&, idx]() {
+            task(idx);
+            std::lock_guard<std::mutex> lock {mutex};
+            if (--nPending == 0) {
+                allDone.notify_one();
+            }
+        });
+    }
+    std::unique_lock<std::mutex> lock {mutex};
+    allDone.wait(lock, [&nPending]() { return nPending == 0; });
+}
+
+boost::asio::thread_pool* TransportNetwork::GetBatchQueryPool() const
+{
+    if (batchQueryPool_ != nullptr) {
+        return batchQueryPool_.get();
     }
+    return &GetDefaultBatchQueryPool();
+}
+
+void TransportNetwork::RunBatchQueries(
+    const size_t nQueries,
+    const std::function<void(size_t)>& query
+) const
+{
+    // We post the queries in chunks, so that the pool threads do not contend
+    // for each query. Each pool thread searches with its own workspace.
+    // A single chunk runs on the calling thread, which is faster than handing
+    // it over to the pool.
+    constexpr size_t chunkSize {64};
+    const auto nChunks {(nQueries + chunkSize - 1) / chunkSize};
+    auto* pool {nChunks > 1 ? GetBatchQueryPool() : nullptr};
+    RunTasks(pool, nChunks, [&](const size_t chunk) {
+        const auto end {std::min(nQueries, (chunk + 1) * chunkSize)};
+        for (auto idx {chunk * chunkSize}; idx < end; ++idx) {
+            query(idx);
+        }
+    });
+}
 
-    // Finally, add the route to the line.
-    lineInternal->routes[route.id] = std::move(routeInternal);
+TransportNetwork::SearchWorkspace& TransportNetwork::GetSearchWorkspace()
+{
+    thread_local SearchWorkspace workspace {};
+    return workspace;
+}
 
-    return true;
+TravelRoute TransportNetwork::GetTravelRoute(
+    const Graph& graph,
+    const Path& path
+) const
+{
+    const auto& stationAId {graph.stationIds[path.front().first.node]};
+    const auto& stationBId {graph.stationIds[path.back().first.node]};
+    const auto& totalTravelTime {path.back().second};
+    TravelRoute travelRoute {
+        stationAId,
+        stationBId,
+        totalTravelTime,
+        {},
+    };
+    travelRoute.steps.reserve(path.size());
+    for (size_t idx {1}; idx < path.size(); ++idx) {
+        const auto& prevStop {path[idx - 1].first};
+        const auto& currStop {path[idx].first};
+        const auto& edge {graph.edges[currStop.edge]};
+        travelRoute.steps.push_back(TravelRoute::Step {
+            graph.stationIds[prevStop.node],
+            graph.stationIds[currStop.node],
+            graph.lineIds[graph.routeLines[edge.route]],
+            graph.routeIds[edge.route],
+            edge.travelTime,
+        });
+    }
+    return travelRoute;
 }
 
 TransportNetwork::Path TransportNetwork::GetFastestTravelRoute(
+    const Graph& graph,
     const TransportNetwork::PathStopDist& stopA,
-    const std::shared_ptr<TransportNetwork::GraphNode>& stationB,
-    const std::unordered_set<
-        TransportNetwork::PathStop, TransportNetwork::PathStopHash
-    >& excludedStops
+    const std::uint32_t stationB,
+    const std::vector<TransportNetwork::PathStop>& excludedStops,
+    const unsigned int maxTravelTime
 ) const
 {
     const auto& stationA {stopA.first.node};
 
     // Corner case: A and B are the same station.
     if (stationA == stationB) {
-        return {{{stationA, nullptr}, 0}};
+        return {{{stationA, kNoEdge}, 0}};
     }
 
     // Supporting data structures for Dijkstra's algorithm.
-    // - Distance of any station from A, through a specific route.
-    std::unordered_map<PathStop, unsigned int, PathStopHash> distFromA {};
-    distFromA[stopA.first] = stopA.second;
-    // - The previous stop in the shortest path.
-    std::unordered_map<PathStop, PathStop, PathStopHash> previousStop {};
-    // - The priority queue of stops to visit.
-    std::priority_queue<
-        PathStopDist,
-        std::vector<PathStopDist>,
-        PathStopDistCmp
-    > nodesToVisit;
-    nodesToVisit.push(stopA);
+    // They all live in the thread workspace, indexed by state:
+    // - Distance of any state from A.
+    // - The previous state in the shortest path.
+    // - The last edge we took to get to the state, to break ties.
+    // - The priority queue of states to visit.
+    auto& workspace {GetSearchWorkspace()};
+    const auto nStates {graph.stateStations.size()};
+    workspace.Reset(
+        nStates,
+        graph.edges.size(),
+        graph.stationIds.size()
+    );
+    const auto generation {workspace.generation};
+    auto& seen {workspace.seen};
+    auto& settled {workspace.settled};
+    auto& distFromA {workspace.distFromA};
+    auto& previousState {workspace.previousState};
+    auto& lastEdge {workspace.lastEdge};
+    auto& nodesToVisit {workspace.nodesToVisit};
+    for (const auto& stop: excludedStops) {
+        if (stop.edge != kNoEdge) {
+            workspace.excluded[stop.edge] = generation;
+        }
+    }
+
+    // In the goal-directed search (A*), we rank the states to visit by their
+    // distance from A plus a lower bound of their distance to B. Without
+    // landmarks, the lower bound is always 0 and we fall back to Dijkstra.
+    const bool goalDirected {
+        graph.goalDirectedSearch &&
+        !graph.landmarks.empty() &&
+        stationB < graph.stationIds.size()
+    };
+    auto getLowerBoundToB {[&](const std::uint32_t station) {
+        if (!goalDirected) {
+            return 0u;
+        }
+        if (workspace.lowerBoundSeen[station] != generation) {
+            workspace.lowerBoundSeen[station] = generation;
+            workspace.lowerBound[station] = GetTravelTimeLowerBound(
+                graph,
+                station,
+                stationB
+            );
+        }
+        return workspace.lowerBound[station];
+    }};
+
+    // The lower bounds also tell us if we can reach B in time at all.
+    // Note: Without the goal-directed search, we can only bound the distance
+    //       from A.
+    if (stopA.second > maxTravelTime ||
+        getLowerBoundToB(stationA) > maxTravelTime - stopA.second) {
+        return {};
+    }
+
+    const auto stateA {GetStopState(graph, stopA.first)};
+    seen[stateA] = generation;
+    distFromA[stateA] = stopA.second;
+    lastEdge[stateA] = stopA.first.edge;
+    nodesToVisit.push_back({
+        stateA,
+        stopA.second + getLowerBoundToB(stationA),
+    });
+
+    // The fastest way to get to station B found so far, if any.
+    bool foundB {false};
+    std::uint32_t stateB {0};
 
     // Dijkstra's algorithm
     while (!nodesToVisit.empty()) {
-        // Remove the node from the priority queue.
-        auto [currStop, currentDistFromA] = nodesToVisit.top();
-        const auto& currStation {currStop.node};
-        const auto& edgeToCurrStation {currStop.edge};
-        nodesToVisit.pop();
+        // Remove the state from the priority queue.
+        std::pop_heap(nodesToVisit.begin(), nodesToVisit.end(),
+                      StateDistCmp {});
+        const auto [currState, currRank] = nodesToVisit.back();
+        const auto currStation {graph.stateStations[currState]};
+        const auto currentDistFromA {distFromA[currState]};
+        nodesToVisit.pop_back();
+
+        // We may have queued the same state multiple times, as we found faster
+        // ways to get to it. Only the fastest one is worth exploring.
+        if (currRank > currentDistFromA + getLowerBoundToB(currStation) ||
+            settled[currState] == generation) {
+            continue;
+        }
+        settled[currState] = generation;
+
+        // Stopping criterion
+        // The lower bounds never decrease along a path, so every state left in
+        // the queue leads to B in at least currRank. Once that is more than
+        // our fastest path to B, we are done.
+        // Note: We keep going on ties, to see all equally fast paths to B and
+        //       apply the same tie-breaking rules as a full search.
+        if (foundB && currRank > distFromA[stateB]) {
+            break;
+        }
 
         // Check if we found station B.
         if (currStation == stationB) {
-            // We do not want to break here! We may still have some nodes in
+            // Parallel routes often serve the same stations with the same
+            // travel times. We break ties on the edge index so that the path
+            // we pick does not depend on the order in which we visit the
+            // network.
+            if (!foundB ||
+                currentDistFromA < distFromA[stateB] ||
+                (currentDistFromA == distFromA[stateB] &&
+                 lastEdge[currState] > lastEdge[stateB])) {
+                foundB = true;
+                stateB = currState;
+            }
+
+            // We do not want to break here! We may still have some states in
             // the queue that may lead to a better path to station B.
             continue;
         }
 
         // Explore the neighborhood.
-        for (const auto& neighborEdge: currStation->edges) {
-            PathStop neighbor {neighborEdge->nextStop, neighborEdge};
-            if (excludedStops.find(neighbor) != excludedStops.end()) {
+        const auto arcsEnd {graph.stateArcOffsets[currState + 1]};
+        for (auto idx {graph.stateArcOffsets[currState]}; idx < arcsEnd;
+             ++idx) {
+            const auto& arc {graph.stateArcs[idx]};
+            if (arc.edge != kNoEdge &&
+                workspace.excluded[arc.edge] == generation) {
+                continue;
+            }
+            const auto& nextState {arc.nextState};
+
+            // Calculate the distance of the next state from station A.
+            // We drop the states that cannot get to station B in time.
+            const auto nextDistFromA {currentDistFromA + arc.travelTime};
+            const auto nextRank {
+                nextDistFromA +
+                    getLowerBoundToB(graph.stateStations[nextState])
+            };
+            if (nextRank > maxTravelTime) {
                 continue;
             }
 
-            // Calculate the distance of the neighbor from station A.
-            auto neighborDistFromA {currentDistFromA + neighborEdge->travelTime};
-            if (edgeToCurrStation != nullptr &&
-                edgeToCurrStation->route != neighborEdge->route
-            ) {
-                // We add a penalty of 5 minutes if we need to change route to
-                // get to our neighbor.
-                neighborDistFromA += 5;
-            }
-
-            // Update our records of the fastest way to get to the neighbor.
-            const auto neighborDistFromAIt {distFromA.find(neighbor)};
-            if (neighborDistFromAIt == distFromA.end()) {
-                // First time we see this neighbor.
-                distFromA[neighbor] = neighborDistFromA;
-                previousStop[neighbor] = currStop;
-                nodesToVisit.push({neighbor, neighborDistFromA});
-            } else {
-                // We already saw this neighbor, and only update our records if
-                // it's worth it.
-                if (neighborDistFromA < neighborDistFromAIt->second) {
-                    distFromA[neighbor] = neighborDistFromA;
-                    previousStop[neighbor] = currStop;
-
-                    // Note: Because there may have been a change of routes in
-                    //       the path to this neighbor, we need to re-walk the
-                    //       path from here onwards.
-                    nodesToVisit.push({neighbor, neighborDistFromA});
+            // A transfer keeps the last edge we rode on.
+            const auto nextLastEdge {
+                arc.edge != kNoEdge ? arc.edge : lastEdge[currState]
+            };
+
+            // Update our records of the fastest way to get to the next state.
+            if (seen[nextState] != generation ||
+                nextDistFromA < distFromA[nextState]) {
+                // First time we see this state, or we found a faster way to
+                // get to it.
+                seen[nextState] = generation;
+                distFromA[nextState] = nextDistFromA;
+                previousState[nextState] = currState;
+                lastEdge[nextState] = nextLastEdge;
+                nodesToVisit.push_back({nextState, nextRank});
+                std::push_heap(nodesToVisit.begin(), nodesToVisit.end(),
+                               StateDistCmp {});
+            } else if (nextDistFromA == distFromA[nextState] &&
+                       nextLastEdge > lastEdge[nextState]) {
+                // Same tie-breaking rule as for station B.
+                // The last edge of a state decides the ties of the states we
+                // transfer to from it, so we need to visit it again.
+                // Note: Without a route change penalty, the network may have
+                //       cycles with no travel time. We must not close them in
+                //       the search tree.
+                if (IsSearchTreeAncestor(
+                        nextState,
+                        currState,
+                        stateA,
+                        previousState.data()
+                    )) {
+                    continue;
+                }
+                previousState[nextState] = currState;
+                lastEdge[nextState] = nextLastEdge;
+                if (settled[nextState] == generation) {
+                    settled[nextState] = 0;
+                    nodesToVisit.push_back({nextState, nextRank});
+                    std::push_heap(nodesToVisit.begin(), nodesToVisit.end(),
+                                   StateDistCmp {});
                 }
             }
         }
     }
 
-    // Valid paths to station B.
-    std::vector<PathStopDist> pathsToB {};
-    for (const auto& [pathStop, distance]: distFromA) {
-        if (pathStop.node == stationB) {
-            pathsToB.push_back({pathStop, distance});
+    // Check if we found no valid path between A and B.
+    if (!foundB) {
+        return {};
+    }
+
+    return GetSearchTreePath(
+        graph,
+        stopA,
+        stateA,
+        stateB,
+        distFromA.data(),
+        previousState.data()
+    );
+}
+
+TransportNetwork::Path TransportNetwork::GetFastestPath(
+    const Graph& graph,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB
+) const
+{
+    const auto& indexes {GetGraphIndexes(graph)};
+    if (!indexes.hasAllPairs) {
+        if (!indexes.hasContractionHierarchy) {
+            return GetFastestTravelRoute(
+                graph,
+                {{stationA, kNoEdge}, 0},
+                stationB
+            );
         }
+        return GetIndexedFastestPath(graph, indexes, stationA, stationB);
     }
 
-    // Check if we found no valid path between A and B.
-    if (pathsToB.empty()) {
+    const auto nStations {graph.stationIds.size()};
+    const auto nStates {graph.stateStations.size()};
+    const auto lastState {indexes.allPairsLastState[stationA * nStations +
+                                                     stationB]};
+    if (lastState == kNoEdge) {
         return {};
     }
+    return GetSearchTreePath(
+        graph,
+        {{stationA, kNoEdge}, 0},
+        static_cast<std::uint32_t>(graph.nRouteStates + stationA),
+        lastState,
+        &indexes.allPairsDistFromA[stationA * nStates],
+        &indexes.allPairsPreviousState[stationA * nStates]
+    );
+}
 
-    // Sort the pathsToB vector to get the fastest path from A to B.
-    std::sort(pathsToB.begin(), pathsToB.end(), PathStopDistCmp {});
-    auto& fastestPathToB {pathsToB.back()};
+TransportNetwork::Path TransportNetwork::GetIndexedFastestPath(
+    const Graph& graph,
+    const GraphIndexes& indexes,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB
+) const
+{
+    const auto nStates {graph.stateStations.size()};
 
-    // Assemble the path.
-    // Note: We go in reverse order, from B to A, because this is how the
-    //       previousStop map is structured.
-    Path path {fastestPathToB};
-    auto& stop {fastestPathToB.first};
-    while (stop.node != stationA) {
-        stop = previousStop.at(stop);
-        const auto& distance {distFromA.at(stop)};
-        path.push_back({stop, distance});
+    // The index path goes from the departure state at A to the arrival node at
+    // B. The ride arcs along the way are our path edges.
+    std::vector<std::uint32_t> nodes {};
+    const auto travelTime {indexes.contractionHierarchy.GetShortestPath(
+        static_cast<std::uint32_t>(graph.nRouteStates + stationA),
+        static_cast<std::uint32_t>(nStates + stationB),
+        nodes
+    )};
+    if (travelTime == ContractionHierarchy::kUnreachable) {
+        return {};
+    }
+    Path path {{{stationA, kNoEdge}, 0}};
+    unsigned int distFromA {0};
+    for (size_t idx {1}; idx + 1 < nodes.size(); ++idx) {
+        const auto* arc {GetRideArc(graph, nodes[idx - 1], nodes[idx])};
+        if (arc == nullptr) {
+            // Transfers go through the departure state of the station: We pay
+            // the penalty to get there, and board the next route for free.
+            if (nodes[idx] >= graph.nRouteStates) {
+                distFromA += graph.routeChangePenalty;
+            }
+            continue;
+        }
+        distFromA += arc->travelTime;
+        path.push_back({{graph.stateStations[nodes[idx]], arc->edge},
+                        distFromA});
     }
-    std::reverse(path.begin(), path.end());
 
     return path;
 }
 
-std::vector<TransportNetwork::Path> TransportNetwork::GetFastestTravelRoutes(
-    const std::shared_ptr<TransportNetwork::GraphNode>& stationA,
-    const std::shared_ptr<TransportNetwork::GraphNode>& stationB,
+std::uint64_t TransportNetwork::GetPathHash(
+    const Path& path
+)
+{
+    // FNV-1a over the path edges. The edges identify the path stops, and the
+    // stops identify their distances.
+    std::uint64_t hash {14695981039346656037ull};
+    for (const auto& [stop, _]: path) {
+        hash ^= stop.edge;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::vector<TransportNetwork::Path> TransportNetwork::GetKFastestPaths(
+    const Graph& graph,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB,
     const double maxSlowdownPc,
     const size_t maxNPaths
 ) const
 {
     // Start by finding the fastest path in the network.
-    const auto fastestPath {GetFastestTravelRoute(
-        {{stationA, nullptr}, 0},
-        stationB
-    )};
+    auto fastestPath {GetFastestPath(graph, stationA, stationB)};
     if (fastestPath.empty()) {
         return {};
     }
-    const auto& minTravelTime {fastestPath.back().second};
+    const auto minTravelTime {fastestPath.back().second};
 
     // Supporting data structures for Yen's algorithm
+    // - All the paths we found, each only once.
+    //   The other data structures refer to a path by its index in this list.
+    //   We also keep a fingerprint of each path, so that we only compare
+    //   whole paths when their fingerprints match.
+    std::vector<Path> paths {};
+    std::vector<std::uint64_t> pathHashes {};
+    auto hashPath {[&pathHashes](const std::uint32_t path) {
+        return static_cast<size_t>(pathHashes[path]);
+    }};
+    auto isSamePath {[&paths, &pathHashes](
+        const std::uint32_t a,
+        const std::uint32_t b
+    ) {
+        return pathHashes[a] == pathHashes[b] && paths[a] == paths[b];
+    }};
+    std::unordered_set<
+        std::uint32_t,
+        decltype(hashPath),
+        decltype(isSamePath)
+    > knownPaths(maxNPaths < 64 ? 4 * maxNPaths : 256, hashPath, isSamePath);
+    // - Add a path, unless we already found it.
+    auto addPath {[&](Path&& path) {
+        paths.emplace_back(std::move(path));
+        pathHashes.push_back(GetPathHash(paths.back()));
+        if (!knownPaths.insert(
+                static_cast<std::uint32_t>(paths.size() - 1)
+            ).second) {
+            paths.pop_back();
+            pathHashes.pop_back();
+            return false;
+        }
+        return true;
+    }};
     // - List of fastest paths
-    std::vector<Path> fastestPaths {fastestPath};
+    addPath(std::move(fastestPath));
+    std::vector<std::uint32_t> fastestPaths {0};
     // - Set of potential k-th shortest paths
     //   We use a priority queue because at the k-th iteration we want to
     //   extract the k-th fastest path among all options found so far.
-    std::priority_queue<Path, std::vector<Path>, PathCmp> potentialPaths;
+    //   Since we only add new paths, each path in the queue is unique and was
+    //   never picked before.
+    auto isSlowerPath {[&paths](
+        const std::uint32_t a,
+        const std::uint32_t b
+    ) {
+        return PathCmp {}(paths[a], paths[b]);
+    }};
+    std::priority_queue<
+        std::uint32_t,
+        std::vector<std::uint32_t>,
+        decltype(isSlowerPath)
+    > potentialPaths {isSlowerPath};
 
     // Differently from Yen's algorithm, we do not calculate a fixed number of
     // paths (k). Instead, we calculate all paths within a certain travel time.
@@ -901,83 +3852,623 @@ std::vector<TransportNetwork::Path> TransportNetwork::GetFastestTravelRoutes(
     const auto maxTravelTime {static_cast<unsigned int>(
         minTravelTime * (1 + maxSlowdownPc)
     )};
+    std::vector<Path> newPaths {};
     while (fastestPaths.size() < maxNPaths) {
-        const auto& lastFastestPath {fastestPaths.back()};
+        const auto& lastFastestPath {paths[fastestPaths.back()]};
 
-        // Find all potential paths for the k-th fastest path.
-        for (size_t idx {0}; idx < lastFastestPath.size() - 1; ++idx) {
+        // Find the potential path that branches off the last fastest path at
+        // the idx-th stop.
+        // Note: This only reads the fastest paths found so far, so we can
+        //       find all potential paths of an iteration in parallel.
+        auto findNewPath {[&](const size_t idx) {
             const auto& rootPathStart {lastFastestPath.begin()};
             const auto& rootPathEnd {lastFastestPath.begin() + idx};
             const auto& spurNode {lastFastestPath[idx]};
+            auto& newPath {newPaths[idx]};
+            newPath.clear();
 
             // Remove the links shared between this path and the previous one.
-            std::unordered_set<PathStop, PathStopHash> removedStops;
-            for (const auto& path: fastestPaths) {
+            std::vector<PathStop> removedStops {};
+            for (const auto& pathIdx: fastestPaths) {
+                const auto& path {paths[pathIdx]};
                 if (idx < path.size() - 1 &&
                     std::equal(
                         path.begin(), path.begin() + idx,
                         rootPathStart, rootPathEnd
                     )) {
-                    removedStops.insert(path[idx + 1].first);
+                    removedStops.push_back(path[idx + 1].first);
                 }
             }
 
             // Find the shortest path from the spur stop to station B.
+            // We only look for paths within our travel time budget, as we
+            // would discard the others anyway.
             const auto spurPath {GetFastestTravelRoute(
+                graph,
                 spurNode,
                 stationB,
-                removedStops
+                removedStops,
+                maxTravelTime
             )};
 
             // Assemble the new potential path.
             // newPath = rootPath + spurPath;
             if (!spurPath.empty()) {
-                Path newPath {};
                 newPath.reserve(idx + 1 + spurPath.size());
                 newPath.insert(newPath.end(),
                                rootPathStart, rootPathEnd);
                 newPath.insert(newPath.end(),
                                spurPath.begin(), spurPath.end());
-                potentialPaths.emplace(std::move(newPath));
+            }
+        }};
+
+        // Find all potential paths for the k-th fastest path.
+        const auto nNewPaths {lastFastestPath.size() - 1};
+        newPaths.resize(nNewPaths);
+        // Each pool thread searches with its own workspace.
+        RunTasks(
+            nNewPaths < 2 ? nullptr : spurSearchPool_.get(),
+            nNewPaths,
+            findNewPath
+        );
+
+        // We queue the potential paths in the order of their spur stop, so
+        // that the result does not depend on the order the searches finish.
+        // We drop the paths we already found before they reach the queue.
+        // Note: Adding paths invalidates lastFastestPath.
+        for (size_t idx {0}; idx < nNewPaths; ++idx) {
+            if (!newPaths[idx].empty() && addPath(std::move(newPaths[idx]))) {
+                potentialPaths.push(
+                    static_cast<std::uint32_t>(paths.size() - 1)
+                );
             }
         }
 
         // Select the k-th fastest path from the queue.
         // The priority queue is sorted so that we always process the fastest
-        // paths first. We may already have found some of these paths, though.
-        bool kthPathFound {false};
-        while (potentialPaths.size() > 0) {
-            auto kthPath {potentialPaths.top()};
-            potentialPaths.pop();
-            if (kthPath.back().second > maxTravelTime) {
-                // Since the queue is sorted, if we got here it means there is
-                // nothing else left to explore that would meet our travel time
-                // requirements.
-                break;
+        // paths first.
+        if (potentialPaths.empty() ||
+            paths[potentialPaths.top()].back().second > maxTravelTime) {
+            // Since the queue is sorted, if we got here it means there is
+            // nothing else left to explore that would meet our travel time
+            // requirements.
+            break;
+        }
+        fastestPaths.push_back(potentialPaths.top());
+        potentialPaths.pop();
+    }
+
+    std::vector<Path> result {};
+    result.reserve(fastestPaths.size());
+    for (const auto& pathIdx: fastestPaths) {
+        result.emplace_back(std::move(paths[pathIdx]));
+    }
+    return result;
+}
+
+void TransportNetwork::GetTravelTimesFrom(
+    const Graph& graph,
+    const std::uint32_t stationA,
+    const std::vector<std::vector<size_t>>& targetColumns,
+    const size_t nTargetStations,
+    unsigned int* row
+) const
+{
+    // Once we record the travel time to a station, we will not find a faster
+    // one. We use this to count the target stations left.
+    size_t nTargetsLeft {nTargetStations};
+    auto recordTravelTime {[&](
+        const std::uint32_t station,
+        const unsigned int travelTime
+    ) {
+        const auto& columns {targetColumns[station]};
+        if (columns.empty() || row[columns.front()] != kUnreachableTravelTime) {
+            return;
+        }
+        for (const auto& column: columns) {
+            row[column] = travelTime;
+        }
+        --nTargetsLeft;
+    }};
+
+    // With the all-pairs tables, we only need to look up the travel times.
+    const auto& indexes {GetGraphIndexes(graph)};
+    if (indexes.hasAllPairs) {
+        const auto nStations {graph.stationIds.size()};
+        const auto nStates {graph.stateStations.size()};
+        for (std::uint32_t station {0}; station < nStations; ++station) {
+            const auto lastState {
+                indexes.allPairsLastState[stationA * nStations + station]
+            };
+            if (lastState != kNoEdge) {
+                recordTravelTime(
+                    station,
+                    indexes.allPairsDistFromA[stationA * nStates + lastState]
+                );
             }
-            if (std::find(fastestPaths.begin(), fastestPaths.end(), kthPath)
-                == fastestPaths.end()) {
-                // We have found the kth fastest path.
-                fastestPaths.emplace_back(std::move(kthPath));
-                kthPathFound = true;
-                break;
+        }
+        return;
+    }
+
+    // Dijkstra's algorithm, on the route-expanded graph.
+    // We only need the travel times, so we do not track the search tree.
+    auto& workspace {GetSearchWorkspace()};
+    workspace.Reset(
+        graph.stateStations.size(),
+        graph.edges.size(),
+        graph.stationIds.size()
+    );
+    const auto generation {workspace.generation};
+    auto& seen {workspace.seen};
+    auto& settled {workspace.settled};
+    auto& distFromA {workspace.distFromA};
+    auto& nodesToVisit {workspace.nodesToVisit};
+    const auto stateA {
+        static_cast<std::uint32_t>(graph.nRouteStates + stationA)
+    };
+    seen[stateA] = generation;
+    distFromA[stateA] = 0;
+    nodesToVisit.push_back({stateA, 0});
+    while (!nodesToVisit.empty() && nTargetsLeft > 0) {
+        std::pop_heap(nodesToVisit.begin(), nodesToVisit.end(),
+                      StateDistCmp {});
+        const auto [currState, currDistFromA] = nodesToVisit.back();
+        nodesToVisit.pop_back();
+        if (settled[currState] == generation) {
+            continue;
+        }
+        settled[currState] = generation;
+        recordTravelTime(graph.stateStations[currState], currDistFromA);
+
+        const auto arcsEnd {graph.stateArcOffsets[currState + 1]};
+        for (auto idx {graph.stateArcOffsets[currState]}; idx < arcsEnd;
+             ++idx) {
+            const auto& arc {graph.stateArcs[idx]};
+            const auto& nextState {arc.nextState};
+            const auto nextDistFromA {currDistFromA + arc.travelTime};
+            if (seen[nextState] != generation ||
+                nextDistFromA < distFromA[nextState]) {
+                seen[nextState] = generation;
+                distFromA[nextState] = nextDistFromA;
+                nodesToVisit.push_back({nextState, nextDistFromA});
+                std::push_heap(nodesToVisit.begin(), nodesToVisit.end(),
+                               StateDistCmp {});
+            }
+        }
+    }
+}
+
+TransportNetwork::Path TransportNetwork::GetQuietestPath(
+    const Graph& graph,
+    const CrowdingModel model,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB,
+    const unsigned int maxTravelTime
+) const
+{
+    // Supporting data structures for the label-setting search.
+    // They all live in the thread workspace:
+    // - All the labels we created.
+    // - The lowest crowding among the labels we settled at each state. We
+    //   settle labels in order of travel time, so any later label at the same
+    //   state with no less crowding is dominated.
+    // - The priority queue of labels to visit.
+    auto& workspace {GetSearchWorkspace()};
+    workspace.Reset(
+        graph.stateStations.size(),
+        graph.edges.size(),
+        graph.stationIds.size()
+    );
+    const auto generation {workspace.generation};
+    auto& seen {workspace.seen};
+    auto& minCrowding {workspace.minCrowding};
+    auto& labels {workspace.labels};
+    auto& labelsToVisit {workspace.labelsToVisit};
+    labels.clear();
+    labelsToVisit.clear();
+
+    // We drop the labels that cannot get to station B in time, using the
+    // same lower bounds as the goal-directed search.
+    const bool goalDirected {
+        graph.goalDirectedSearch && !graph.landmarks.empty()
+    };
+    auto getLowerBoundToB {[&](const std::uint32_t station) {
+        if (!goalDirected) {
+            return 0u;
+        }
+        if (workspace.lowerBoundSeen[station] != generation) {
+            workspace.lowerBoundSeen[station] = generation;
+            workspace.lowerBound[station] = GetTravelTimeLowerBound(
+                graph,
+                station,
+                stationB
+            );
+        }
+        return workspace.lowerBound[station];
+    }};
+    if (getLowerBoundToB(stationA) > maxTravelTime) {
+        return {};
+    }
+
+    labels.push_back({
+        static_cast<std::uint32_t>(graph.nRouteStates + stationA),
+        kNoEdge,
+        0,
+        0,
+        kNoEdge,
+    });
+    labelsToVisit.push_back({0, labels.back().crowding, 0});
+
+    // The most quiet way to get to station B found so far, if any.
+    bool foundB {false};
+    std::uint32_t labelB {0};
+
+    while (!labelsToVisit.empty()) {
+        std::pop_heap(labelsToVisit.begin(), labelsToVisit.end(),
+                      std::greater<QuietLabelRank> {});
+        const auto currLabelIdx {std::get<2>(labelsToVisit.back())};
+        labelsToVisit.pop_back();
+        const auto currLabel {labels[currLabelIdx]};
+        const auto& currState {currLabel.state};
+        const auto currStation {graph.stateStations[currState]};
+
+        // Pareto dominance check.
+        if (seen[currState] == generation &&
+            currLabel.crowding >= minCrowding[currState]) {
+            continue;
+        }
+        seen[currState] = generation;
+        minCrowding[currState] = currLabel.crowding;
+
+        // Crowding never decreases along a path, so once we get to station B
+        // we only keep the labels that are more quiet. We get to B with the
+        // fastest of the equally quiet labels first.
+        if (currStation == stationB) {
+            if (!foundB || currLabel.crowding < labels[labelB].crowding) {
+                foundB = true;
+                labelB = currLabelIdx;
+            }
+            continue;
+        }
+
+        // Extend the label along the state arcs.
+        const auto arcsEnd {graph.stateArcOffsets[currState + 1]};
+        for (auto idx {graph.stateArcOffsets[currState]}; idx < arcsEnd;
+             ++idx) {
+            const auto& arc {graph.stateArcs[idx]};
+            const auto& nextState {arc.nextState};
+            const auto nextStation {graph.stateStations[nextState]};
+            const auto nextTravelTime {currLabel.travelTime + arc.travelTime};
+
+            // Changing route at station A is never faster than boarding the
+            // other route there, and we count the crowding of station A on
+            // the route we board.
+            if (arc.edge == kNoEdge && currState < graph.nRouteStates &&
+                currStation == stationA) {
+                continue;
+            }
+            if (nextTravelTime + getLowerBoundToB(nextStation) >
+                maxTravelTime) {
+                continue;
+            }
+
+            // We only count the crowding of the stops we ride to, and of the
+            // first stop when we board a route there.
+            const auto nextCrowding {
+                currLabel.crowding +
+                    (arc.edge != kNoEdge || currState >= graph.nRouteStates ?
+                        GetStateCrowding(graph, model, nextState) : 0)
+            };
+            if ((foundB && nextCrowding >= labels[labelB].crowding) ||
+                (seen[nextState] == generation &&
+                 nextCrowding >= minCrowding[nextState])) {
+                continue;
+            }
+            labels.push_back({
+                nextState,
+                arc.edge,
+                nextTravelTime,
+                nextCrowding,
+                currLabelIdx,
+            });
+            labelsToVisit.push_back({
+                nextTravelTime,
+                nextCrowding,
+                static_cast<std::uint32_t>(labels.size() - 1),
+            });
+            std::push_heap(labelsToVisit.begin(), labelsToVisit.end(),
+                           std::greater<QuietLabelRank> {});
+        }
+    }
+
+    // Check if we found no valid path between A and B.
+    if (!foundB) {
+        return {};
+    }
+
+    // Assemble the path, from B back to A. We only keep the stops we got to
+    // through a ride arc.
+    Path path {};
+    for (auto labelIdx {labelB}; labelIdx != kNoEdge;
+         labelIdx = labels[labelIdx].previousLabel) {
+        const auto& label {labels[labelIdx]};
+        if (label.edge != kNoEdge) {
+            path.push_back({
+                {graph.stateStations[label.state], label.edge},
+                label.travelTime,
+            });
+        }
+    }
+    path.push_back({{stationA, kNoEdge}, 0});
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+TransportNetwork::Path TransportNetwork::GetLagrangianPath(
+    const Graph& graph,
+    const CrowdingModel model,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB,
+    const double lambda
+) const
+{
+    // Supporting data structures for Dijkstra's algorithm.
+    // They all live in the thread workspace, indexed by state:
+    // - Cost of any state from A.
+    // - Travel time of any state from A, to break ties.
+    // - The previous state in the cheapest path.
+    // - The priority queue of states to visit.
+    auto& workspace {GetSearchWorkspace()};
+    workspace.Reset(
+        graph.stateStations.size(),
+        graph.edges.size(),
+        graph.stationIds.size()
+    );
+    const auto generation {workspace.generation};
+    auto& seen {workspace.seen};
+    auto& settled {workspace.settled};
+    auto& costFromA {workspace.costFromA};
+    auto& distFromA {workspace.distFromA};
+    auto& previousState {workspace.previousState};
+    auto& costsToVisit {workspace.costsToVisit};
+    costsToVisit.clear();
+
+    const auto stateA {
+        static_cast<std::uint32_t>(graph.nRouteStates + stationA)
+    };
+    seen[stateA] = generation;
+    costFromA[stateA] = 0.0;
+    distFromA[stateA] = 0;
+    costsToVisit.push_back({0.0, 0, stateA});
+
+    bool foundB {false};
+    std::uint32_t stateB {0};
+    using CostRank = std::tuple<double, unsigned int, std::uint32_t>;
+    while (!costsToVisit.empty()) {
+        std::pop_heap(costsToVisit.begin(), costsToVisit.end(),
+                      std::greater<CostRank> {});
+        const auto [currCost, currDistFromA, currState] = costsToVisit.back();
+        costsToVisit.pop_back();
+        if (settled[currState] == generation) {
+            continue;
+        }
+        settled[currState] = generation;
+
+        // The first state at station B we settle is the cheapest one.
+        if (graph.stateStations[currState] == stationB) {
+            foundB = true;
+            stateB = currState;
+            break;
+        }
+
+        const auto arcsEnd {graph.stateArcOffsets[currState + 1]};
+        for (auto idx {graph.stateArcOffsets[currState]}; idx < arcsEnd;
+             ++idx) {
+            const auto& arc {graph.stateArcs[idx]};
+            const auto& nextState {arc.nextState};
+
+            // Changing route at station A is never faster than boarding the
+            // other route there, and we count the crowding of station A on
+            // the route we board.
+            if (arc.edge == kNoEdge && currState < graph.nRouteStates &&
+                graph.stateStations[currState] == stationA) {
+                continue;
             }
+
+            // We only count the crowding of the stops we ride to, and of the
+            // first stop when we board a route there.
+            const auto nextCrowding {
+                arc.edge != kNoEdge || currState >= graph.nRouteStates ?
+                    GetStateCrowding(graph, model, nextState) : 0
+            };
+            const auto nextCost {
+                currCost + nextCrowding + lambda * arc.travelTime
+            };
+            const auto nextDistFromA {currDistFromA + arc.travelTime};
+            if (seen[nextState] != generation ||
+                nextCost < costFromA[nextState] ||
+                (nextCost == costFromA[nextState] &&
+                 nextDistFromA < distFromA[nextState])) {
+                seen[nextState] = generation;
+                costFromA[nextState] = nextCost;
+                distFromA[nextState] = nextDistFromA;
+                previousState[nextState] = currState;
+                costsToVisit.push_back({nextCost, nextDistFromA, nextState});
+                std::push_heap(costsToVisit.begin(), costsToVisit.end(),
+                               std::greater<CostRank> {});
+            }
+        }
+    }
+
+    // Check if we found no valid path between A and B.
+    if (!foundB) {
+        return {};
+    }
+
+    return GetSearchTreePath(
+        graph,
+        {{stationA, kNoEdge}, 0},
+        stateA,
+        stateB,
+        distFromA.data(),
+        previousState.data()
+    );
+}
+
+TransportNetwork::Path TransportNetwork::GetLagrangianQuietestPath(
+    const Graph& graph,
+    const CrowdingModel model,
+    const std::uint32_t stationA,
+    const std::uint32_t stationB,
+    const unsigned int maxTravelTime,
+    const Path& fastestPath
+) const
+{
+    // Start from the most quiet path. If it is fast enough, we are done.
+    auto infeasiblePath {
+        GetLagrangianPath(graph, model, stationA, stationB, 0.0)
+    };
+    if (infeasiblePath.empty()) {
+        return {};
+    }
+    if (infeasiblePath.back().second <= maxTravelTime) {
+        return infeasiblePath;
+    }
+
+    // LARAC algorithm
+    // We keep a path that is fast enough and one that is not, but more quiet.
+    // The multiplier that gives both paths the same cost is the slope of the
+    // line between them. If no path is cheaper than both with this
+    // multiplier, the fast enough path is the best one we can find.
+    auto feasiblePath {fastestPath};
+    for (size_t iteration {0}; iteration < kMaxLagrangianIterations;
+         ++iteration) {
+        const auto feasibleCrowding {
+            static_cast<double>(GetPathCrowding(graph, model, feasiblePath))
+        };
+        const auto infeasibleCrowding {
+            static_cast<double>(GetPathCrowding(graph, model, infeasiblePath))
+        };
+        const auto feasibleTime {
+            static_cast<double>(feasiblePath.back().second)
+        };
+        const auto infeasibleTime {
+            static_cast<double>(infeasiblePath.back().second)
+        };
+        if (infeasibleCrowding >= feasibleCrowding) {
+            break;
         }
-        if (!kthPathFound) {
+        const auto lambda {
+            (feasibleCrowding - infeasibleCrowding) /
+            (infeasibleTime - feasibleTime)
+        };
+        auto path {
+            GetLagrangianPath(graph, model, stationA, stationB, lambda)
+        };
+        const double pathCost {
+            GetPathCrowding(graph, model, path) + lambda * path.back().second
+        };
+        const auto feasibleCost {feasibleCrowding + lambda * feasibleTime};
+        if (pathCost >= feasibleCost - 1e-9 * (1 + feasibleCost)) {
             break;
         }
+        if (path.back().second <= maxTravelTime) {
+            feasiblePath = std::move(path);
+        } else {
+            infeasiblePath = std::move(path);
+        }
+    }
+    return feasiblePath;
+}
+
+std::uint32_t TransportNetwork::GetRouteStop(
+    const Graph& graph,
+    const std::uint32_t station,
+    const std::uint32_t route
+)
+{
+    const auto routeStopIt {graph.routeStops.find(
+        static_cast<std::uint64_t>(route) << 32 | station
+    )};
+    return routeStopIt != graph.routeStops.end() ? routeStopIt->second :
+                                                   kNoEdge;
+}
+
+unsigned int TransportNetwork::GetStopCrowding(
+    const Graph& graph,
+    const CrowdingModel model,
+    const std::uint32_t station,
+    const std::uint32_t routeStop
+) const
+{
+    const auto& passengerCounts {*graph.passengerCounts};
+    switch (model) {
+        case CrowdingModel::kCumulative: {
+            auto passengerCount {passengerCounts.Get(station)};
+            if (routeStop != kNoEdge) {
+                passengerCount += passengerCounts.GetAtRouteStop(routeStop);
+            }
+            return passengerCount > 0 ?
+                static_cast<unsigned int>(passengerCount) : 0;
+        }
+        case CrowdingModel::kDecayed: {
+            auto passengerCount {passengerCounts.GetDecayed(station)};
+            if (routeStop != kNoEdge) {
+                passengerCount +=
+                    passengerCounts.GetDecayedAtRouteStop(routeStop);
+            }
+            return passengerCount > 0.0 ?
+                static_cast<unsigned int>(std::lround(passengerCount)) : 0;
+        }
+        default:
+            return 0;
     }
+}
 
-    return fastestPaths;
+unsigned int TransportNetwork::GetStateCrowding(
+    const Graph& graph,
+    const CrowdingModel model,
+    const std::uint32_t state
+) const
+{
+    return GetStopCrowding(
+        graph,
+        model,
+        graph.stateStations[state],
+        state < graph.nRouteStates ? graph.stateRouteStops[state] : kNoEdge
+    );
 }
 
 unsigned int TransportNetwork::GetPathCrowding(
+    const Graph& graph,
+    const CrowdingModel model,
     const Path& path
 ) const
 {
-    unsigned int totPassengerCount {0};
-    for (const auto& [stop, _]: path) {
-        totPassengerCount += stop.node->passengerCount;
+    if (path.empty()) {
+        return 0;
+    }
+
+    // We count the first stop on the route we board there.
+    const auto& firstStation {path.front().first.node};
+    const auto firstRouteStop {path.size() > 1 ?
+        GetRouteStop(
+            graph,
+            firstStation,
+            graph.edges[path[1].first.edge].route
+        ) : kNoEdge
+    };
+    unsigned int totPassengerCount {
+        GetStopCrowding(graph, model, firstStation, firstRouteStop)
+    };
+    for (size_t idx {1}; idx < path.size(); ++idx) {
+        const auto& stop {path[idx].first};
+        totPassengerCount += GetStopCrowding(
+            graph,
+            model,
+            stop.node,
+            graph.stateRouteStops[graph.edgeStates[stop.edge]]
+        );
     }
     return totPassengerCount;
 }
\ No newline at end of file
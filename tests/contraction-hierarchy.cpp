@@ -0,0 +1,174 @@
+#include <network-monitor/contraction-hierarchy.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <utility>
+#include <vector>
+
+using NetworkMonitor::ContractionHierarchy;
+
+using Arc = ContractionHierarchy::Arc;
+
+// Reference shortest path lengths from a source, with Dijkstra's algorithm.
+static std::vector<unsigned int> GetDistances(
+    const size_t nNodes,
+    const std::vector<Arc>& arcs,
+    const std::uint32_t source
+)
+{
+    using NodeDist = std::pair<unsigned int, std::uint32_t>;
+    std::vector<unsigned int> dist(nNodes, ContractionHierarchy::kUnreachable);
+    std::priority_queue<
+        NodeDist,
+        std::vector<NodeDist>,
+        std::greater<NodeDist>
+    > nodesToVisit {};
+    dist[source] = 0;
+    nodesToVisit.push({0, source});
+    while (!nodesToVisit.empty()) {
+        const auto [nodeDist, node] = nodesToVisit.top();
+        nodesToVisit.pop();
+        if (nodeDist > dist[node]) {
+            continue;
+        }
+        for (const auto& arc: arcs) {
+            if (arc.from == node && nodeDist + arc.weight < dist[arc.to]) {
+                dist[arc.to] = nodeDist + arc.weight;
+                nodesToVisit.push({dist[arc.to], arc.to});
+            }
+        }
+    }
+    return dist;
+}
+
+// Get the length of a path, or kUnreachable if it uses a missing arc.
+static unsigned int GetPathLength(
+    const std::vector<Arc>& arcs,
+    const std::vector<std::uint32_t>& path
+)
+{
+    unsigned int length {0};
+    for (size_t idx {1}; idx < path.size(); ++idx) {
+        unsigned int weight {ContractionHierarchy::kUnreachable};
+        for (const auto& arc: arcs) {
+            if (arc.from == path[idx - 1] && arc.to == path[idx]) {
+                weight = std::min(weight, arc.weight);
+            }
+        }
+        if (weight == ContractionHierarchy::kUnreachable) {
+            return weight;
+        }
+        length += weight;
+    }
+    return length;
+}
+
+BOOST_AUTO_TEST_SUITE(network_monitor);
+
+BOOST_AUTO_TEST_SUITE(class_ContractionHierarchy);
+
+BOOST_AUTO_TEST_CASE(empty)
+{
+    ContractionHierarchy ch {};
+    BOOST_CHECK(ch.IsEmpty());
+    std::vector<std::uint32_t> path {};
+    auto dist {ch.GetShortestPath(0, 0, path)};
+    BOOST_CHECK_EQUAL(dist, ContractionHierarchy::kUnreachable);
+    BOOST_CHECK(path.empty());
+}
+
+BOOST_AUTO_TEST_CASE(basic)
+{
+    // 0 ---> 1 ---> 2 ---> 3
+    // |                    ^
+    // +-----------> 4 -----+
+    std::vector<Arc> arcs {
+        {0, 1, 1},
+        {1, 2, 1},
+        {2, 3, 1},
+        {0, 4, 1},
+        {4, 3, 5},
+    };
+    ContractionHierarchy ch {5, arcs};
+    BOOST_REQUIRE(!ch.IsEmpty());
+    BOOST_CHECK_EQUAL(ch.GetNNodes(), 5);
+
+    std::vector<std::uint32_t> path {};
+    auto dist {ch.GetShortestPath(0, 3, path)};
+    BOOST_CHECK_EQUAL(dist, 3);
+    std::vector<std::uint32_t> expectedPath {0, 1, 2, 3};
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+        path.begin(), path.end(),
+        expectedPath.begin(), expectedPath.end()
+    );
+
+    // Same node
+    dist = ch.GetShortestPath(2, 2, path);
+    BOOST_CHECK_EQUAL(dist, 0);
+    BOOST_CHECK_EQUAL(path.size(), 1);
+
+    // Arcs are directed.
+    dist = ch.GetShortestPath(3, 0, path);
+    BOOST_CHECK_EQUAL(dist, ContractionHierarchy::kUnreachable);
+    BOOST_CHECK(path.empty());
+
+    // Nodes outside of the graph
+    dist = ch.GetShortestPath(0, 5, path);
+    BOOST_CHECK_EQUAL(dist, ContractionHierarchy::kUnreachable);
+}
+
+BOOST_AUTO_TEST_CASE(parallel_arcs)
+{
+    std::vector<Arc> arcs {
+        {0, 1, 4},
+        {0, 1, 2},
+        {1, 2, 3},
+        {1, 2, 7},
+    };
+    ContractionHierarchy ch {3, arcs};
+    std::vector<std::uint32_t> path {};
+    auto dist {ch.GetShortestPath(0, 2, path)};
+    BOOST_CHECK_EQUAL(dist, 5);
+    BOOST_CHECK_EQUAL(path.size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(random_graph)
+{
+    // We compare the index with plain Dijkstra's algorithm on a random graph
+    // with many equivalent paths.
+    const size_t nNodes {200};
+    std::mt19937 rng {42};
+    std::uniform_int_distribution<std::uint32_t> nodeDist(0, nNodes - 1);
+    std::uniform_int_distribution<unsigned int> weightDist(0, 10);
+    std::vector<Arc> arcs {};
+    for (size_t idx {0}; idx < nNodes * 4; ++idx) {
+        arcs.push_back({nodeDist(rng), nodeDist(rng), weightDist(rng)});
+    }
+    ContractionHierarchy ch {nNodes, arcs};
+
+    std::vector<std::uint32_t> path {};
+    for (std::uint32_t source {0}; source < nNodes; source += 3) {
+        const auto expectedDist {GetDistances(nNodes, arcs, source)};
+        for (std::uint32_t target {0}; target < nNodes; ++target) {
+            auto dist {ch.GetShortestPath(source, target, path)};
+            BOOST_REQUIRE_EQUAL(dist, expectedDist[target]);
+            if (dist == ContractionHierarchy::kUnreachable) {
+                continue;
+            }
+            BOOST_REQUIRE(!path.empty());
+            BOOST_CHECK_EQUAL(path.front(), source);
+            BOOST_CHECK_EQUAL(path.back(), target);
+            BOOST_CHECK_EQUAL(GetPathLength(arcs, path), dist);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // class_ContractionHierarchy
+
+BOOST_AUTO_TEST_SUITE_END(); // network_monitor
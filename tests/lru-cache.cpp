@@ -0,0 +1,148 @@
+#include <network-monitor/lru-cache.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+
+using NetworkMonitor::LruCache;
+
+BOOST_AUTO_TEST_SUITE(network_monitor);
+
+BOOST_AUTO_TEST_SUITE(class_LruCache);
+
+BOOST_AUTO_TEST_CASE(get_put)
+{
+    LruCache<int, std::string> cache {2};
+    std::string value {};
+    BOOST_CHECK(!cache.Get(0, value));
+    cache.Put(0, "zero");
+    cache.Put(1, "one");
+    BOOST_CHECK_EQUAL(cache.GetSize(), 2);
+    BOOST_REQUIRE(cache.Get(0, value));
+    BOOST_CHECK_EQUAL(value, "zero");
+
+    // Replacing a value does not take more room.
+    cache.Put(1, "uno");
+    BOOST_CHECK_EQUAL(cache.GetSize(), 2);
+    BOOST_REQUIRE(cache.Get(1, value));
+    BOOST_CHECK_EQUAL(value, "uno");
+
+    BOOST_CHECK_EQUAL(cache.GetNHits(), 2);
+    BOOST_CHECK_EQUAL(cache.GetNMisses(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(eviction)
+{
+    LruCache<int, int> cache {2};
+    int value {0};
+    cache.Put(0, 0);
+    cache.Put(1, 1);
+
+    // Key 1 is now the least recently used one.
+    BOOST_CHECK(cache.Get(0, value));
+    cache.Put(2, 2);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 2);
+    BOOST_CHECK(cache.Get(0, value));
+    BOOST_CHECK(!cache.Get(1, value));
+    BOOST_CHECK(cache.Get(2, value));
+
+    // Shrinking the cache evicts the least recently used keys.
+    cache.SetCapacity(1);
+    BOOST_CHECK(!cache.Get(0, value));
+    BOOST_CHECK(cache.Get(2, value));
+
+    // A cache with no capacity stores nothing, and does not count misses.
+    cache.SetCapacity(0);
+    const auto nMisses {cache.GetNMisses()};
+    cache.Put(3, 3);
+    BOOST_CHECK_EQUAL(cache.GetSize(), 0);
+    BOOST_CHECK(!cache.Get(3, value));
+    BOOST_CHECK_EQUAL(cache.GetNMisses(), nMisses);
+}
+
+BOOST_AUTO_TEST_CASE(validation)
+{
+    LruCache<int, int> cache {2};
+    int value {0};
+    cache.Put(0, 10);
+    const auto isPositive {[](const int cached) { return cached > 0; }};
+    BOOST_CHECK(cache.Get(0, value, isPositive));
+
+    // Invalid entries are misses, and we drop them.
+    cache.Put(0, -10);
+    BOOST_CHECK(!cache.Get(0, value, isPositive));
+    BOOST_CHECK_EQUAL(cache.GetSize(), 0);
+    BOOST_CHECK_EQUAL(cache.GetNHits(), 1);
+    BOOST_CHECK_EQUAL(cache.GetNMisses(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(validation_unlocked, *boost::unit_test::timeout {10})
+{
+    LruCache<int, int> cache {2};
+    int value {0};
+    cache.Put(0, -10);
+
+    // The check can use the cache. We keep an entry that was replaced while
+    // we were checking the old one.
+    const auto replace {[&cache](const int cached) {
+        cache.Put(0, 10);
+        return cached > 0;
+    }};
+    BOOST_CHECK(!cache.Get(0, value, replace));
+    BOOST_CHECK_EQUAL(cache.GetSize(), 1);
+    BOOST_REQUIRE(cache.Get(0, value));
+    BOOST_CHECK_EQUAL(value, 10);
+}
+
+BOOST_AUTO_TEST_CASE(copy)
+{
+    LruCache<int, int> cache {2};
+    int value {0};
+    cache.Put(0, 0);
+    cache.Put(1, 1);
+    auto copied {cache};
+    cache.Clear();
+    BOOST_CHECK(!cache.Get(0, value));
+
+    // The copy keeps its own entries and order.
+    BOOST_CHECK(copied.Get(0, value));
+    copied.Put(2, 2);
+    BOOST_CHECK(!copied.Get(1, value));
+    BOOST_CHECK(copied.Get(2, value));
+}
+
+BOOST_AUTO_TEST_CASE(concurrency, *boost::unit_test::timeout {10})
+{
+    LruCache<int, int> cache {64};
+    const size_t nThreads {4};
+    const size_t nOps {10000};
+    std::atomic<int> nWrongValues {0};
+    std::vector<std::thread> threads {};
+    for (size_t thread {0}; thread < nThreads; ++thread) {
+        threads.emplace_back([&cache, &nWrongValues, thread]() {
+            int value {0};
+            for (size_t op {0}; op < nOps; ++op) {
+                const int key {static_cast<int>((op * 7 + thread) % 128)};
+                if (!cache.Get(key, value)) {
+                    cache.Put(key, key);
+                } else if (value != key) {
+                    ++nWrongValues;
+                }
+            }
+        });
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    BOOST_CHECK_EQUAL(nWrongValues.load(), 0);
+    BOOST_CHECK_EQUAL(cache.GetNHits() + cache.GetNMisses(), nThreads * nOps);
+    BOOST_CHECK_LE(cache.GetSize(), 64);
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // class_LruCache
+
+BOOST_AUTO_TEST_SUITE_END(); // network_monitor
@@ -6,19 +6,29 @@
 #include <nlohmann/json.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+using NetworkMonitor::CrowdingModel;
 using NetworkMonitor::Id;
 using NetworkMonitor::Line;
 using NetworkMonitor::PassengerEvent;
 using NetworkMonitor::ParseJsonFile;
+using NetworkMonitor::QuietRouteSearch;
+using NetworkMonitor::ReachableStation;
 using NetworkMonitor::Route;
+using NetworkMonitor::StationHandle;
 using NetworkMonitor::Station;
 using NetworkMonitor::TransportNetwork;
 using NetworkMonitor::TravelRoute;
@@ -270,6 +280,65 @@ BOOST_AUTO_TEST_CASE(missing_stations)
     BOOST_CHECK(ok);
 }
 
+BOOST_AUTO_TEST_CASE(failed_then_retried)
+{
+    TransportNetwork nw {};
+    bool ok {true};
+    ok &= nw.AddStation({"station_000", "Station Name 0"});
+    ok &= nw.AddStation({"station_001", "Station Name 1"});
+    ok &= nw.AddStation({"station_002", "Station Name 2"});
+    BOOST_REQUIRE(ok);
+
+    // Expected fail: route1 stops at a station that is not in the network,
+    // even if route0 is valid.
+    // route0: 0 ---> 1
+    // route1: 0 ---> 3
+    Line badLine {
+        "line_000",
+        "Line Name",
+        {
+            {"route_000", "inbound", "line_000", "station_000", "station_001",
+             {"station_000", "station_001"}},
+            {"route_001", "inbound", "line_000", "station_000", "station_003",
+             {"station_000", "station_003"}},
+        },
+    };
+    BOOST_REQUIRE(!nw.AddLine(badLine));
+
+    // The failed line leaves nothing behind.
+    BOOST_CHECK(!nw.SetTravelTime("station_000", "station_001", 5));
+    BOOST_CHECK(nw.GetRoutesServingStation("station_000").empty());
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime("line_000", "route_000", "station_000", "station_001"),
+        0
+    );
+
+    // Expected success: We retry with a different route0.
+    // route0: 0 ---> 2
+    Line line {
+        "line_000",
+        "Line Name",
+        {
+            {"route_000", "inbound", "line_000", "station_000", "station_002",
+             {"station_000", "station_002"}},
+        },
+    };
+    BOOST_REQUIRE(nw.AddLine(line));
+    BOOST_REQUIRE(nw.SetTravelTime("station_000", "station_002", 7));
+    BOOST_CHECK(!nw.SetTravelTime("station_000", "station_001", 5));
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime("line_000", "route_000", "station_000", "station_002"),
+        7
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime("line_000", "route_000", "station_000", "station_001"),
+        0
+    );
+    const std::vector<Id> routes {"route_000"};
+    BOOST_CHECK(nw.GetRoutesServingStation("station_000") == routes);
+    BOOST_CHECK(nw.GetRoutesServingStation("station_001").empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // AddLine
 
 BOOST_AUTO_TEST_SUITE(PassengerEvents);
@@ -348,6 +417,83 @@ BOOST_AUTO_TEST_CASE(basic)
     BOOST_CHECK_EQUAL(nw.GetPassengerCount(station2.id), -1);
 }
 
+BOOST_AUTO_TEST_CASE(routes)
+{
+    TransportNetwork nw {};
+    bool ok {false};
+
+    // Add a line with 2 routes.
+    // route0: 0 ---> 1 ---> 2
+    // route1:        1 <--- 2
+    Station station0 {
+        "station_000",
+        "Station Name 0",
+    };
+    Station station1 {
+        "station_001",
+        "Station Name 1",
+    };
+    Station station2 {
+        "station_002",
+        "Station Name 2",
+    };
+    Route route0 {
+        "route_000",
+        "inbound",
+        "line_000",
+        "station_000",
+        "station_002",
+        {"station_000", "station_001", "station_002"},
+    };
+    Route route1 {
+        "route_001",
+        "outbound",
+        "line_000",
+        "station_002",
+        "station_001",
+        {"station_002", "station_001"},
+    };
+    Line line {
+        "line_000",
+        "Line Name",
+        {route0, route1},
+    };
+    ok = true;
+    ok &= nw.AddStation(station0);
+    ok &= nw.AddStation(station1);
+    ok &= nw.AddStation(station2);
+    BOOST_REQUIRE(ok);
+    ok = nw.AddLine(line);
+    BOOST_REQUIRE(ok);
+
+    // The station count includes the events on all its routes.
+    using EventType = PassengerEvent::Type;
+    ok = nw.RecordPassengerEvent({station1.id, EventType::In, {}, route0.id});
+    BOOST_REQUIRE(ok);
+    ok = nw.RecordPassengerEvent({station1.id, EventType::In, {}, route1.id});
+    BOOST_REQUIRE(ok);
+    ok = nw.RecordPassengerEvent({station1.id, EventType::In});
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station1.id), 3);
+    ok = nw.RecordPassengerEvent({station1.id, EventType::Out, {}, route0.id});
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station1.id), 2);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station0.id), 0);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station2.id), 0);
+
+    // The route must serve the station.
+    ok = nw.RecordPassengerEvent({station0.id, EventType::In, {}, route1.id});
+    BOOST_CHECK(!ok);
+    ok = nw.RecordPassengerEvent({station0.id, EventType::In, {}, "route_42"});
+    BOOST_CHECK(!ok);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station0.id), 0);
+
+    // The counts survive network changes.
+    ok = nw.AddStation({"station_003", "Station Name 3"});
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount(station1.id), 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // PassengerEvents
 
 BOOST_AUTO_TEST_SUITE(GetRoutesServingStation);
@@ -431,8 +577,85 @@ BOOST_AUTO_TEST_CASE(lone_station)
     BOOST_CHECK_EQUAL(routes.size(), 0);
 }
 
+BOOST_AUTO_TEST_CASE(handles)
+{
+    auto testFilePath {
+        std::filesystem::path(TEST_DATA) / "from_json_1line_2routes.json"
+    };
+    auto src = ParseJsonFile(testFilePath);
+
+    TransportNetwork nw {};
+    auto ok {nw.FromJson(std::move(src))};
+    BOOST_REQUIRE(ok);
+
+    // The handle-based overload agrees with the ID-based one, for all
+    // stations, including the route end stops.
+    for (StationHandle station {0}; nw.GetStationId(station) != ""; ++station) {
+        const auto routeIds {
+            nw.GetRoutesServingStation(nw.GetStationId(station))
+        };
+        const auto routes {nw.GetRoutesServingStation(station)};
+        BOOST_REQUIRE_EQUAL(routes.size(), routeIds.size());
+        for (size_t idx {0}; idx < routes.size(); ++idx) {
+            BOOST_CHECK_EQUAL(nw.GetRouteId(routes[idx]), routeIds[idx]);
+        }
+    }
+    const auto routes {
+        nw.GetRoutesServingStation(nw.LookupStation("station_1"))
+    };
+    BOOST_CHECK_EQUAL(routes.size(), 2);
+
+    // The list outlives the graph it came from.
+    BOOST_REQUIRE(nw.AddStation({"station_new", "New Station"}));
+    BOOST_CHECK(
+        routes == nw.GetRoutesServingStation(nw.LookupStation("station_1"))
+    );
+
+    // Invalid handles
+    BOOST_CHECK(nw.GetRoutesServingStation(
+        NetworkMonitor::kInvalidStationHandle
+    ).empty());
+    BOOST_CHECK_EQUAL(nw.GetRouteId(2), "");
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // GetRoutesServingStation
 
+BOOST_AUTO_TEST_SUITE(StationHandles);
+
+BOOST_AUTO_TEST_CASE(basic)
+{
+    TransportNetwork nw {};
+    bool ok {false};
+
+    Station station0 {
+        "station_000",
+        "Station Name 0",
+    };
+    Station station1 {
+        "station_001",
+        "Station Name 1",
+    };
+    ok = true;
+    ok &= nw.AddStation(station0);
+    ok &= nw.AddStation(station1);
+    BOOST_REQUIRE(ok);
+
+    // Handles are dense and follow the order in which we added the stations.
+    BOOST_CHECK_EQUAL(nw.LookupStation(station0.id), 0);
+    BOOST_CHECK_EQUAL(nw.LookupStation(station1.id), 1);
+    BOOST_CHECK_EQUAL(nw.GetStationId(0), station0.id);
+    BOOST_CHECK_EQUAL(nw.GetStationId(1), station1.id);
+
+    // Stations not in the network
+    BOOST_CHECK_EQUAL(nw.LookupStation("station_42"),
+                      NetworkMonitor::kInvalidStationHandle);
+    BOOST_CHECK_EQUAL(nw.GetStationId(2), "");
+    BOOST_CHECK_EQUAL(nw.GetStationId(NetworkMonitor::kInvalidStationHandle),
+                      "");
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // StationHandles
+
 BOOST_AUTO_TEST_SUITE(TravelTime);
 
 BOOST_AUTO_TEST_CASE(basic)
@@ -609,6 +832,76 @@ BOOST_AUTO_TEST_CASE(over_route)
     BOOST_CHECK_EQUAL(
         nw.GetTravelTime(line.id, route0.id, station1.id, station1.id), 0
     );
+    // -- The route must be on a line in the network.
+    Line otherLine {
+        "line_001",
+        "Line Name",
+        {{"route_100", "inbound", "line_001", "station_000", "station_001",
+          {"station_000", "station_001"}}},
+    };
+    BOOST_REQUIRE(nw.AddLine(otherLine));
+    BOOST_REQUIRE(nw.SetTravelTime(station0.id, station1.id, 1));
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(otherLine.id, "route_100", station0.id, station1.id),
+        1
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, "route_100", station0.id, station1.id), 0
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(otherLine.id, route0.id, station0.id, station1.id), 0
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime("line_002", route0.id, station0.id, station1.id), 0
+    );
+
+    // Updating a travel time updates the cumulative travel times of all
+    // routes through the two stations.
+    ok = nw.SetTravelTime(station1.id, station2.id, 5);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station0.id, station3.id), 1 + 5 + 3
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route1.id, station3.id, station2.id), 4 + 5
+    );
+    // -- Only the stops after the updated segment move.
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station0.id, station1.id), 1
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station1.id, station2.id), 5
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station2.id, station3.id), 3
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route2.id, station3.id, station0.id), 4 + 1
+    );
+    // -- Station B must come after station A on the route, also after an
+    //    update.
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station3.id, station0.id), 0
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station2.id, station1.id), 0
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route1.id, station2.id, station3.id), 0
+    );
+
+    // A later update replaces the earlier one.
+    ok = nw.SetTravelTime(station1.id, station2.id, 2);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station0.id, station3.id), 1 + 2 + 3
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route0.id, station1.id, station3.id), 2 + 3
+    );
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime(line.id, route1.id, station3.id, station2.id), 4 + 2
+    );
 }
 
 BOOST_AUTO_TEST_SUITE_END(); // TravelTime
@@ -749,89 +1042,472 @@ BOOST_AUTO_TEST_CASE(fail_on_bad_travel_times)
     BOOST_REQUIRE(!ok);
 }
 
+BOOST_AUTO_TEST_CASE(fail_on_bad_travel_time_values)
+{
+    // Travel times must be unsigned integers that fit in an unsigned int.
+    const auto src = ParseJsonFile(
+        std::filesystem::path(TEST_DATA) / "from_json_travel_times.json"
+    );
+    for (const nlohmann::json& travelTime: {
+        nlohmann::json(-1),
+        nlohmann::json(1.5),
+        nlohmann::json(4294967296ull),
+    }) {
+        auto badSrc = src;
+        badSrc.at("travel_times").at(0).at("travel_time") = travelTime;
+        BOOST_CHECK_THROW(
+            TransportNetwork {}.FromJson(std::move(badSrc)),
+            std::runtime_error
+        );
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // FromJson
 
-BOOST_AUTO_TEST_SUITE(Routes);
+BOOST_AUTO_TEST_SUITE(FromJsonFile);
 
-static std::pair<TransportNetwork, TravelRoute> GetTestNetwork(
-    const std::string& filenameNoExtension,
-    bool useOriginalNetworkLayoutFile = false,
-    bool readPassengerCounts = false,
-    const std::string& resultFilenamePost = ""
-)
+BOOST_AUTO_TEST_CASE(from_json_travel_times)
 {
-    auto testFilePath {useOriginalNetworkLayoutFile ?
-        std::filesystem::path(TESTS_NETWORK_LAYOUT_JSON) :
-        std::filesystem::path(TEST_DATA) / (filenameNoExtension + ".json")
-    };
-    auto src = ParseJsonFile(testFilePath);
-    BOOST_REQUIRE(src != nlohmann::json::object());
     TransportNetwork nw {};
-    auto ok {nw.FromJson(std::move(src))};
+    auto ok {nw.FromJsonFile(
+        std::filesystem::path(TEST_DATA) / "from_json_travel_times.json"
+    )};
     BOOST_REQUIRE(ok);
 
-    if (readPassengerCounts) {
-        auto passengerCountsFilePath {
-            std::filesystem::path(TEST_DATA) /
-            (filenameNoExtension + ".counts.json")
-        };
-        auto passengerCountsJson = ParseJsonFile(passengerCountsFilePath);
-        std::unordered_map<Id, int> passengerCounts {};
-        try {
-            passengerCounts = passengerCountsJson.get<
-                std::unordered_map<Id, int>
-            >();
-        } catch (...) {
-            BOOST_FAIL(std::string("Failed to parse passenger counts file: ") +
-                       passengerCountsFilePath.string());
-        }
-        for (const auto& [stationId, passengerCount]: passengerCounts) {
-            auto type {passengerCount > 0 ? PassengerEvent::Type::In :
-                                            PassengerEvent::Type::Out};
-            for (size_t _ {0}; _ < std::abs(passengerCount); ++_) {
-                nw.RecordPassengerEvent({stationId, type, {}});
-            }
-        }
-    }
-
-    auto resultFilePath {
-        std::filesystem::path(TEST_DATA) /
-        (filenameNoExtension + ".result." +
-         (resultFilenamePost == "" ? "json" : (resultFilenamePost + ".json")))
-    };
-    auto travelRouteJson = ParseJsonFile(resultFilePath);
-    TravelRoute travelRoute;
-    try {
-        travelRoute = travelRouteJson.get<TravelRoute>();
-    } catch (...) {
-        BOOST_FAIL(std::string("Failed to parse result JSON file: ") +
-                   resultFilePath.string());
-    }
-    return std::make_pair<TransportNetwork, TravelRoute>(
-        std::move(nw),
-        std::move(travelRoute)
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_0", "station_1"), 1);
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_1", "station_0"), 1);
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_1", "station_2"), 2);
+    BOOST_CHECK_EQUAL(
+        nw.GetTravelTime("line_0", "route_0", "station_0", "station_2"), 1 + 2
     );
 }
 
-BOOST_AUTO_TEST_SUITE(GetFastestTravelRoute);
-
-BOOST_AUTO_TEST_CASE(same_station)
+BOOST_AUTO_TEST_CASE(network_layout, *timeout {20})
 {
-    auto [nw, resultTravelRoute] = GetTestNetwork(
-        "network_fastest_path_same_station"
-    );
-    auto travelRoute {nw.GetFastestTravelRoute("station_A", "station_A")};
-    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
+    auto src = ParseJsonFile(std::filesystem::path(TESTS_NETWORK_LAYOUT_JSON));
+    std::vector<Id> stationIds {};
+    for (const auto& station: src.at("stations")) {
+        stationIds.push_back(station.at("station_id").get<Id>());
+    }
+    TransportNetwork nw {};
+    BOOST_REQUIRE(nw.FromJson(std::move(src)));
+
+    // In this file, the lines come before the stations.
+    TransportNetwork streamed {};
+    BOOST_REQUIRE(streamed.FromJsonFile(TESTS_NETWORK_LAYOUT_JSON));
+    for (const auto& station: stationIds) {
+        BOOST_CHECK(
+            streamed.GetRoutesServingStation(station) ==
+            nw.GetRoutesServingStation(station)
+        );
+    }
+    for (size_t idx {0}; idx < stationIds.size(); idx += 37) {
+        for (size_t otherIdx {5}; otherIdx < stationIds.size();
+             otherIdx += 41) {
+            const auto& stationA {stationIds[idx]};
+            const auto& stationB {stationIds[otherIdx]};
+            BOOST_CHECK_EQUAL(
+                streamed.GetFastestTravelRoute(stationA, stationB),
+                nw.GetFastestTravelRoute(stationA, stationB)
+            );
+        }
+    }
 }
 
-BOOST_AUTO_TEST_CASE(missing_station)
+BOOST_AUTO_TEST_CASE(from_buffer)
 {
-    auto [nw, resultTravelRoute] = GetTestNetwork(
-        "network_fastest_path_missing_station"
-    );
-    auto travelRoute {nw.GetFastestTravelRoute("station_A", "station_X")};
-    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
-}
+    // The travel times come first, and the items have fields we do not need.
+    const std::string src {R"({
+        "travel_times": [
+            {
+                "start_station_id": "station_1",
+                "end_station_id": "station_0",
+                "travel_time": 3,
+                "route_id": "route_0"
+            }
+        ],
+        "lines": [
+            {
+                "line_id": "line_0",
+                "name": "Line 0 Name",
+                "routes": [
+                    {
+                        "route_id": "route_0",
+                        "direction": "inbound",
+                        "line_id": "line_0",
+                        "start_station_id": "station_0",
+                        "end_station_id": "station_1",
+                        "route_stops": ["station_0", "station_1"],
+                        "stops_count": 2
+                    }
+                ],
+                "stations": ["station_0", "station_1"]
+            }
+        ],
+        "stations": [
+            {"station_id": "station_0", "name": "Station 0 Name"},
+            {"station_id": "station_1", "name": "Station 1 Name", "zone": 1}
+        ]
+    })"};
+    TransportNetwork nw {};
+    BOOST_REQUIRE(nw.FromJsonBuffer(src));
+    BOOST_CHECK_EQUAL(nw.GetTravelTime("station_0", "station_1"), 3);
+    auto routes {nw.GetRoutesServingStation("station_1")};
+    BOOST_REQUIRE_EQUAL(routes.size(), 1);
+    BOOST_CHECK_EQUAL(routes[0], "route_0");
+}
+
+BOOST_AUTO_TEST_CASE(fail_on_bad_json)
+{
+    TransportNetwork nw {};
+    BOOST_CHECK_THROW(
+        nw.FromJsonFile(
+            std::filesystem::path(TEST_DATA) / "bad_json_file.json"
+        ),
+        nlohmann::json::parse_error
+    );
+    BOOST_CHECK_THROW(
+        TransportNetwork {}.FromJsonFile(
+            std::filesystem::path(TEST_DATA) / "missing_file.json"
+        ),
+        std::runtime_error
+    );
+
+    // Missing "stations"!
+    BOOST_CHECK_THROW(
+        TransportNetwork {}.FromJsonBuffer(
+            R"({"lines": [], "travel_times": []})"
+        ),
+        std::runtime_error
+    );
+
+    // This number does not fit in a double.
+    BOOST_CHECK_THROW(
+        TransportNetwork {}.FromJsonBuffer(R"({"zone": 1e400})"),
+        nlohmann::json::out_of_range
+    );
+}
+
+BOOST_AUTO_TEST_CASE(fail_on_good_json_bad_items)
+{
+    // station_0 is a duplicate!
+    BOOST_CHECK_THROW(
+        TransportNetwork {}.FromJsonBuffer(R"({
+            "stations": [
+                {"station_id": "station_0", "name": "Station 0 Name"},
+                {"station_id": "station_0", "name": "Station 0 Name"}
+            ],
+            "lines": [],
+            "travel_times": []
+        })"),
+        std::runtime_error
+    );
+
+    // station_1 has no name!
+    BOOST_CHECK_THROW(
+        TransportNetwork {}.FromJsonBuffer(R"({
+            "stations": [
+                {"station_id": "station_0", "name": "Station 0 Name"},
+                {"station_id": "station_1"}
+            ],
+            "lines": [],
+            "travel_times": []
+        })"),
+        std::runtime_error
+    );
+
+    // This line goes through a station that is not defined.
+    BOOST_CHECK_THROW(
+        TransportNetwork {}.FromJsonFile(
+            std::filesystem::path(TEST_DATA) / "bad_network_layout_file.json"
+        ),
+        std::runtime_error
+    );
+}
+
+BOOST_AUTO_TEST_CASE(fail_on_bad_travel_times)
+{
+    TransportNetwork nw {};
+    auto ok {nw.FromJsonFile(
+        std::filesystem::path(TEST_DATA) / "from_json_bad_travel_times.json"
+    )};
+    BOOST_REQUIRE(!ok);
+}
+
+BOOST_AUTO_TEST_CASE(fail_on_bad_travel_time_values)
+{
+    // We reject the same travel times as FromJson.
+    const auto src = ParseJsonFile(
+        std::filesystem::path(TEST_DATA) / "from_json_travel_times.json"
+    );
+    for (const nlohmann::json& travelTime: {
+        nlohmann::json(-1),
+        nlohmann::json(1.5),
+        nlohmann::json(4294967296ull),
+    }) {
+        auto badSrc = src;
+        badSrc.at("travel_times").at(0).at("travel_time") = travelTime;
+        BOOST_CHECK_THROW(
+            TransportNetwork {}.FromJsonBuffer(badSrc.dump()),
+            std::runtime_error
+        );
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // FromJsonFile
+
+BOOST_AUTO_TEST_SUITE(Snapshot);
+
+static std::vector<char> ReadFileBytes(
+    const std::filesystem::path& file
+)
+{
+    std::ifstream in {file, std::ios::binary};
+    return {std::istreambuf_iterator<char> {in}, {}};
+}
+
+static void WriteFileBytes(
+    const std::filesystem::path& file,
+    const std::vector<char>& bytes
+)
+{
+    std::ofstream out {file, std::ios::binary | std::ios::trunc};
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+// Update the checksum of an edited snapshot. The checksum is the FNV-1a hash
+// of the file after the 40-byte header, at offset 24.
+static void SealSnapshotBytes(
+    std::vector<char>& bytes
+)
+{
+    std::uint64_t hash {0xcbf29ce484222325};
+    for (size_t idx {40}; idx < bytes.size(); ++idx) {
+        hash ^= static_cast<unsigned char>(bytes[idx]);
+        hash *= 0x100000001b3;
+    }
+    std::memcpy(bytes.data() + 24, &hash, sizeof(hash));
+}
+
+BOOST_AUTO_TEST_CASE(round_trip, *timeout {20})
+{
+    auto src = ParseJsonFile(std::filesystem::path(TESTS_NETWORK_LAYOUT_JSON));
+    std::vector<Id> stationIds {};
+    for (const auto& station: src.at("stations")) {
+        stationIds.push_back(station.at("station_id").get<Id>());
+    }
+    TransportNetwork nw {};
+    BOOST_REQUIRE(nw.FromJson(std::move(src)));
+    const auto file {
+        std::filesystem::temp_directory_path() / "network-snapshot.bin"
+    };
+    BOOST_REQUIRE(nw.SaveSnapshot(file));
+
+    TransportNetwork loaded {};
+    BOOST_REQUIRE(loaded.LoadSnapshot(file));
+
+    // Only an empty network can load a snapshot.
+    BOOST_CHECK(!loaded.LoadSnapshot(file));
+
+    // The same passenger events give the same quiet routes.
+    using EventType = PassengerEvent::Type;
+    for (size_t idx {0}; idx < stationIds.size(); idx += 3) {
+        BOOST_REQUIRE(nw.RecordPassengerEvent({stationIds[idx], EventType::In}));
+        BOOST_REQUIRE(loaded.RecordPassengerEvent({
+            stationIds[idx], EventType::In
+        }));
+    }
+    for (const auto& station: stationIds) {
+        BOOST_CHECK(
+            loaded.GetRoutesServingStation(station) ==
+            nw.GetRoutesServingStation(station)
+        );
+    }
+    for (size_t idx {0}; idx < stationIds.size(); idx += 37) {
+        for (size_t otherIdx {5}; otherIdx < stationIds.size();
+             otherIdx += 41) {
+            const auto& stationA {stationIds[idx]};
+            const auto& stationB {stationIds[otherIdx]};
+            BOOST_CHECK_EQUAL(
+                loaded.GetFastestTravelRoute(stationA, stationB),
+                nw.GetFastestTravelRoute(stationA, stationB)
+            );
+            BOOST_CHECK_EQUAL(
+                loaded.GetQuietTravelRoute(stationA, stationB, 0.1, 0.1, 20),
+                nw.GetQuietTravelRoute(stationA, stationB, 0.1, 0.1, 20)
+            );
+        }
+    }
+
+    // The loaded network can still change.
+    BOOST_CHECK(loaded.AddStation({"station_new", "New Station"}));
+    std::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(route_change_penalty, *timeout {20})
+{
+    auto src = ParseJsonFile(std::filesystem::path(TESTS_NETWORK_LAYOUT_JSON));
+    TransportNetwork nw {};
+    BOOST_REQUIRE(nw.FromJson(std::move(src)));
+    const auto file {
+        std::filesystem::temp_directory_path() / "network-snapshot.bin"
+    };
+    BOOST_REQUIRE(nw.SaveSnapshot(file));
+
+    // A snapshot saved with a different penalty still gives the routes of
+    // the current penalty.
+    nw.SetRouteChangePenalty(0);
+    TransportNetwork loaded {};
+    loaded.SetRouteChangePenalty(0);
+    BOOST_REQUIRE(loaded.LoadSnapshot(file));
+    BOOST_CHECK_EQUAL(
+        loaded.GetFastestTravelRoute("station_004", "station_152"),
+        nw.GetFastestTravelRoute("station_004", "station_152")
+    );
+    std::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(rejected, *timeout {20})
+{
+    auto src = ParseJsonFile(std::filesystem::path(TESTS_NETWORK_LAYOUT_JSON));
+    TransportNetwork nw {};
+    BOOST_REQUIRE(nw.FromJson(std::move(src)));
+    const auto file {
+        std::filesystem::temp_directory_path() / "network-snapshot.bin"
+    };
+    const auto badFile {
+        std::filesystem::temp_directory_path() / "network-snapshot-bad.bin"
+    };
+    BOOST_REQUIRE(nw.SaveSnapshot(file));
+    const auto bytes {ReadFileBytes(file)};
+    BOOST_REQUIRE(bytes.size() > 1000);
+
+    TransportNetwork loaded {};
+    BOOST_CHECK(!loaded.LoadSnapshot(
+        std::filesystem::temp_directory_path() / "nonexistent-snapshot.bin"
+    ));
+
+    // Truncated
+    WriteFileBytes(badFile, {bytes.begin(), bytes.begin() + 1000});
+    BOOST_CHECK(!loaded.LoadSnapshot(badFile));
+
+    // Corrupt
+    auto corrupt {bytes};
+    corrupt[corrupt.size() / 2] ^= 0x01;
+    WriteFileBytes(badFile, corrupt);
+    BOOST_CHECK(!loaded.LoadSnapshot(badFile));
+
+    // Stale: The layout version follows the 8-byte magic string.
+    auto stale {bytes};
+    stale[8] ^= 0x01;
+    WriteFileBytes(badFile, stale);
+    BOOST_CHECK(!loaded.LoadSnapshot(badFile));
+
+    // Inconsistent, with a valid checksum: The last departure state is at
+    // the wrong station. The section table follows the header, and has an
+    // offset and a size for each section. The state stations are section 9.
+    auto inconsistent {bytes};
+    std::uint64_t sectionEntry[2] {};
+    std::memcpy(sectionEntry, inconsistent.data() + 40 + 9 * 16, 16);
+    const auto lastState {sectionEntry[0] + sectionEntry[1] - 4};
+    std::uint32_t station {0};
+    std::memcpy(&station, inconsistent.data() + lastState, sizeof(station));
+    BOOST_REQUIRE(station > 0);
+    station = 0;
+    std::memcpy(inconsistent.data() + lastState, &station, sizeof(station));
+    SealSnapshotBytes(inconsistent);
+    WriteFileBytes(badFile, inconsistent);
+    BOOST_CHECK(!loaded.LoadSnapshot(badFile));
+
+    // The network stays empty, and can still load a good snapshot.
+    BOOST_CHECK(loaded.LoadSnapshot(file));
+    std::filesystem::remove(file);
+    std::filesystem::remove(badFile);
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // Snapshot
+
+BOOST_AUTO_TEST_SUITE(Routes);
+
+static std::pair<TransportNetwork, TravelRoute> GetTestNetwork(
+    const std::string& filenameNoExtension,
+    bool useOriginalNetworkLayoutFile = false,
+    bool readPassengerCounts = false,
+    const std::string& resultFilenamePost = ""
+)
+{
+    auto testFilePath {useOriginalNetworkLayoutFile ?
+        std::filesystem::path(TESTS_NETWORK_LAYOUT_JSON) :
+        std::filesystem::path(TEST_DATA) / (filenameNoExtension + ".json")
+    };
+    auto src = ParseJsonFile(testFilePath);
+    BOOST_REQUIRE(src != nlohmann::json::object());
+    TransportNetwork nw {};
+    auto ok {nw.FromJson(std::move(src))};
+    BOOST_REQUIRE(ok);
+
+    if (readPassengerCounts) {
+        auto passengerCountsFilePath {
+            std::filesystem::path(TEST_DATA) /
+            (filenameNoExtension + ".counts.json")
+        };
+        auto passengerCountsJson = ParseJsonFile(passengerCountsFilePath);
+        std::unordered_map<Id, int> passengerCounts {};
+        try {
+            passengerCounts = passengerCountsJson.get<
+                std::unordered_map<Id, int>
+            >();
+        } catch (...) {
+            BOOST_FAIL(std::string("Failed to parse passenger counts file: ") +
+                       passengerCountsFilePath.string());
+        }
+        for (const auto& [stationId, passengerCount]: passengerCounts) {
+            auto type {passengerCount > 0 ? PassengerEvent::Type::In :
+                                            PassengerEvent::Type::Out};
+            for (size_t _ {0}; _ < std::abs(passengerCount); ++_) {
+                nw.RecordPassengerEvent({stationId, type, {}});
+            }
+        }
+    }
+
+    auto resultFilePath {
+        std::filesystem::path(TEST_DATA) /
+        (filenameNoExtension + ".result." +
+         (resultFilenamePost == "" ? "json" : (resultFilenamePost + ".json")))
+    };
+    auto travelRouteJson = ParseJsonFile(resultFilePath);
+    TravelRoute travelRoute;
+    try {
+        travelRoute = travelRouteJson.get<TravelRoute>();
+    } catch (...) {
+        BOOST_FAIL(std::string("Failed to parse result JSON file: ") +
+                   resultFilePath.string());
+    }
+    return std::make_pair<TransportNetwork, TravelRoute>(
+        std::move(nw),
+        std::move(travelRoute)
+    );
+}
+
+BOOST_AUTO_TEST_SUITE(GetFastestTravelRoute);
+
+BOOST_AUTO_TEST_CASE(same_station)
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork(
+        "network_fastest_path_same_station"
+    );
+    auto travelRoute {nw.GetFastestTravelRoute("station_A", "station_A")};
+    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
+}
+
+BOOST_AUTO_TEST_CASE(missing_station)
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork(
+        "network_fastest_path_missing_station"
+    );
+    auto travelRoute {nw.GetFastestTravelRoute("station_A", "station_X")};
+    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
+}
 
 BOOST_AUTO_TEST_CASE(no_path)
 {
@@ -883,6 +1559,453 @@ BOOST_AUTO_TEST_CASE(ltc_path2, *timeout {1})
     BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
 }
 
+BOOST_AUTO_TEST_CASE(station_handles, *timeout {1})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork("ltc_path1", true);
+    const auto stationA {nw.LookupStation("station_003")};
+    const auto stationB {nw.LookupStation("station_019")};
+    auto travelRoute {nw.GetFastestTravelRoute(stationA, stationB)};
+    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
+
+    // Invalid handles behave like stations that are not in the network.
+    travelRoute = nw.GetFastestTravelRoute(
+        stationA,
+        NetworkMonitor::kInvalidStationHandle
+    );
+    BOOST_CHECK_EQUAL(travelRoute, TravelRoute {});
+}
+
+BOOST_AUTO_TEST_CASE(goal_directed, *timeout {5})
+{
+    auto [nw, _] = GetTestNetwork("ltc_path1", true);
+    TransportNetwork nwDijkstra {nw};
+    nwDijkstra.SetGoalDirectedSearch(false);
+
+    // We compare the two search modes on a sample of station pairs.
+    const StationHandle nStations {426};
+    BOOST_REQUIRE(nw.GetStationId(nStations - 1) != "");
+    BOOST_REQUIRE(nw.GetStationId(nStations) == "");
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 7) {
+        for (StationHandle stationB {3}; stationB < nStations; stationB += 11) {
+            BOOST_CHECK_EQUAL(
+                nw.GetFastestTravelRoute(stationA, stationB),
+                nwDijkstra.GetFastestTravelRoute(stationA, stationB)
+            );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(goal_directed_concurrent, *timeout {20})
+{
+    auto [nw, _] = GetTestNetwork("ltc_path1", true);
+    std::vector<std::pair<StationHandle, StationHandle>> queries {};
+    std::vector<TravelRoute> travelRoutes {};
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 37) {
+        for (StationHandle stationB {3}; stationB < nStations;
+             stationB += 41) {
+            queries.emplace_back(stationA, stationB);
+            travelRoutes.push_back(
+                nw.GetFastestTravelRoute(stationA, stationB)
+            );
+        }
+    }
+
+    // Queries read the search mode of their graph, so switching it while they
+    // run does not change their routes.
+    std::atomic<bool> done {false};
+    std::atomic<size_t> nWrongRoutes {0};
+    std::vector<std::thread> readers {};
+    for (size_t idx {0}; idx < 4; ++idx) {
+        readers.emplace_back([&, &nw = nw]() {
+            while (!done) {
+                for (size_t query {0}; query < queries.size(); ++query) {
+                    const auto& [stationA, stationB] = queries[query];
+                    if (!(nw.GetFastestTravelRoute(stationA, stationB) ==
+                          travelRoutes[query])) {
+                        ++nWrongRoutes;
+                    }
+                }
+            }
+        });
+    }
+    for (size_t idx {0}; idx < 200; ++idx) {
+        nw.SetGoalDirectedSearch(idx % 2 != 0);
+        nw.SetQuietRouteCrowdingTolerance(idx % 2 == 0 ? 0.1 : 0.0);
+    }
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    BOOST_CHECK_EQUAL(nWrongRoutes.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(precomputed, *timeout {10})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork("ltc_path1", true);
+    auto [nwPrecomputed, _] = GetTestNetwork("ltc_path1", true);
+    nwPrecomputed.PrecomputeFastestTravelRoutes();
+
+    auto checkSamePaths {[&nw = nw, &nwPrecomputed = nwPrecomputed]() {
+        const StationHandle nStations {426};
+        for (StationHandle stationA {0}; stationA < nStations; stationA += 7) {
+            for (StationHandle stationB {3}; stationB < nStations;
+                 stationB += 11) {
+                BOOST_CHECK_EQUAL(
+                    nwPrecomputed.GetFastestTravelRoute(stationA, stationB),
+                    nw.GetFastestTravelRoute(stationA, stationB)
+                );
+            }
+        }
+    }};
+    checkSamePaths();
+    BOOST_CHECK_EQUAL(
+        nwPrecomputed.GetFastestTravelRoute("station_003", "station_019"),
+        resultTravelRoute
+    );
+
+    // The precomputed paths follow the changes in travel times.
+    const auto& step {resultTravelRoute.steps.at(0)};
+    bool ok {true};
+    ok &= nw.SetTravelTime(step.startStationId, step.endStationId, 30);
+    ok &= nwPrecomputed.SetTravelTime(step.startStationId, step.endStationId,
+                                      30);
+    BOOST_REQUIRE(ok);
+    checkSamePaths();
+    BOOST_CHECK(!(
+        nwPrecomputed.GetFastestTravelRoute("station_003", "station_019") ==
+        resultTravelRoute
+    ));
+
+    // Batch queries on a single thread can rebuild the table after a change.
+    nwPrecomputed.SetBatchQueryThreads(1);
+    ok &= nw.SetTravelTime(step.startStationId, step.endStationId, 1);
+    ok &= nwPrecomputed.SetTravelTime(step.startStationId, step.endStationId,
+                                      1);
+    BOOST_REQUIRE(ok);
+    std::vector<std::pair<StationHandle, StationHandle>> queries {};
+    for (StationHandle stationA {0}; stationA < 426; stationA += 5) {
+        queries.emplace_back(stationA, 425 - stationA);
+    }
+    BOOST_CHECK(
+        nwPrecomputed.GetFastestTravelRoutes(queries) ==
+        nw.GetFastestTravelRoutes(queries)
+    );
+    checkSamePaths();
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_updates, *timeout {20})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork("ltc_path1", true);
+    nw.SetRouteCacheCapacity(16);
+    const auto& step {resultTravelRoute.steps.at(0)};
+    const auto setTravelTime {[&nw = nw, &step](const unsigned int time) {
+        return nw.SetTravelTime(step.startStationId, step.endStationId, time);
+    }};
+    const auto getTravelTime {[&nw = nw]() {
+        return nw.GetFastestTravelRoute("station_003", "station_019")
+            .totalTravelTime;
+    }};
+    const auto isStepTravelTime {[&nw = nw, &step]() {
+        const auto travelTime {
+            nw.GetTravelTime(step.startStationId, step.endStationId)
+        };
+        const auto routeTravelTime {nw.GetTravelTime(
+            step.lineId,
+            step.routeId,
+            step.startStationId,
+            step.endStationId
+        )};
+        return (travelTime == 30 || travelTime == step.travelTime) &&
+            (routeTravelTime == 30 || routeTravelTime == step.travelTime) &&
+            nw.GetRoutesServingStation(step.startStationId).size() > 0;
+    }};
+    BOOST_REQUIRE(setTravelTime(30));
+    const auto slowTravelTime {getTravelTime()};
+    BOOST_REQUIRE(setTravelTime(step.travelTime));
+    const auto fastTravelTime {getTravelTime()};
+    BOOST_REQUIRE_EQUAL(fastTravelTime, resultTravelRoute.totalTravelTime);
+    BOOST_REQUIRE(slowTravelTime != fastTravelTime);
+
+    // Queries see either version of the network while we update it.
+    std::atomic<bool> done {false};
+    std::atomic<size_t> nWrongTravelTimes {0};
+    std::vector<std::thread> readers {};
+    for (size_t idx {0}; idx < 4; ++idx) {
+        readers.emplace_back([&]() {
+            while (!done) {
+                const auto travelTime {getTravelTime()};
+                if ((travelTime != slowTravelTime &&
+                     travelTime != fastTravelTime) || !isStepTravelTime()) {
+                    ++nWrongTravelTimes;
+                }
+            }
+        });
+    }
+    bool ok {true};
+    for (size_t idx {0}; idx < 50; ++idx) {
+        ok &= setTravelTime(idx % 2 == 0 ? 30 : step.travelTime);
+    }
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    BOOST_CHECK(ok);
+    BOOST_CHECK_EQUAL(nWrongTravelTimes.load(), 0);
+
+    // The cache does not keep routes from older versions.
+    BOOST_CHECK_EQUAL(getTravelTime(), fastTravelTime);
+}
+
+BOOST_AUTO_TEST_CASE(contraction_hierarchy, *timeout {10})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork("ltc_path1", true);
+    auto [nwIndexed, _] = GetTestNetwork("ltc_path1", true);
+    BOOST_CHECK_EQUAL(nwIndexed.GetContractionHierarchyMemoryUsage(), 0);
+    nwIndexed.PrecomputeContractionHierarchy();
+    BOOST_CHECK(nwIndexed.GetContractionHierarchyMemoryUsage() > 0);
+
+    // Among equally fast routes, the index may pick a different one, so we
+    // only compare the travel times.
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 7) {
+        for (StationHandle stationB {3}; stationB < nStations; stationB += 11) {
+            const auto travelRoute {
+                nwIndexed.GetFastestTravelRoute(stationA, stationB)
+            };
+            const auto expectedTravelRoute {
+                nw.GetFastestTravelRoute(stationA, stationB)
+            };
+            BOOST_CHECK_EQUAL(travelRoute.totalTravelTime,
+                              expectedTravelRoute.totalTravelTime);
+            BOOST_CHECK_EQUAL(travelRoute.steps.size() == 0,
+                              expectedTravelRoute.steps.size() == 0);
+        }
+    }
+    BOOST_CHECK_EQUAL(
+        nwIndexed.GetFastestTravelRoute("station_003", "station_019")
+            .totalTravelTime,
+        resultTravelRoute.totalTravelTime
+    );
+
+    // Changes do not rebuild the index. The next query does.
+    const auto& step {resultTravelRoute.steps.at(0)};
+    bool ok {true};
+    ok &= nw.SetTravelTime(step.startStationId, step.endStationId, 30);
+    ok &= nwIndexed.SetTravelTime(step.startStationId, step.endStationId, 30);
+    BOOST_REQUIRE(ok);
+    BOOST_CHECK_EQUAL(nwIndexed.GetContractionHierarchyMemoryUsage(), 0);
+    BOOST_CHECK_EQUAL(
+        nwIndexed.GetFastestTravelRoute("station_003", "station_019")
+            .totalTravelTime,
+        nw.GetFastestTravelRoute("station_003", "station_019").totalTravelTime
+    );
+    BOOST_CHECK(nwIndexed.GetContractionHierarchyMemoryUsage() > 0);
+    BOOST_CHECK_EQUAL(
+        nwIndexed.GetFastestTravelRoute("station_019", "station_003")
+            .totalTravelTime,
+        nw.GetFastestTravelRoute("station_019", "station_003").totalTravelTime
+    );
+}
+
+BOOST_AUTO_TEST_CASE(route_change_penalty, *timeout {10})
+{
+    auto [nw, _] = GetTestNetwork("ltc_path1", true);
+    BOOST_CHECK_EQUAL(nw.GetRouteChangePenalty(), 5);
+    TransportNetwork nwNoPenalty {nw};
+    nwNoPenalty.SetRouteChangePenalty(0);
+    BOOST_CHECK_EQUAL(nwNoPenalty.GetRouteChangePenalty(), 0);
+    TransportNetwork nwIndexed {nwNoPenalty};
+    nwIndexed.PrecomputeContractionHierarchy();
+
+    // Without the penalty, the travel time is the sum of the step travel times,
+    // and routes with changes get faster.
+    bool fasterRouteFound {false};
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 7) {
+        for (StationHandle stationB {3}; stationB < nStations; stationB += 11) {
+            const auto travelRoute {
+                nwNoPenalty.GetFastestTravelRoute(stationA, stationB)
+            };
+            const auto defaultTravelRoute {
+                nw.GetFastestTravelRoute(stationA, stationB)
+            };
+            unsigned int stepsTravelTime {0};
+            for (const auto& step: travelRoute.steps) {
+                stepsTravelTime += step.travelTime;
+            }
+            BOOST_CHECK_EQUAL(travelRoute.totalTravelTime, stepsTravelTime);
+            BOOST_CHECK(travelRoute.totalTravelTime <=
+                        defaultTravelRoute.totalTravelTime);
+            fasterRouteFound |= travelRoute.totalTravelTime <
+                                defaultTravelRoute.totalTravelTime;
+            BOOST_CHECK_EQUAL(
+                nwIndexed.GetFastestTravelRoute(stationA, stationB)
+                    .totalTravelTime,
+                travelRoute.totalTravelTime
+            );
+        }
+    }
+    BOOST_CHECK(fasterRouteFound);
+}
+
+BOOST_AUTO_TEST_CASE(route_change_penalty_concurrent, *timeout {30})
+{
+    auto [nw, _] = GetTestNetwork("ltc_path1", true);
+    nw.PrecomputeContractionHierarchy();
+    TransportNetwork nwNoPenalty {nw};
+    nwNoPenalty.SetRouteChangePenalty(0);
+
+    // Find a route that gets faster without the penalty.
+    const StationHandle nStations {426};
+    StationHandle stationA {0};
+    StationHandle stationB {0};
+    unsigned int slowTravelTime {0};
+    unsigned int fastTravelTime {0};
+    for (StationHandle station {1}; station < nStations; ++station) {
+        slowTravelTime = nw.GetFastestTravelRoute(0, station).totalTravelTime;
+        fastTravelTime = nwNoPenalty.GetFastestTravelRoute(0, station)
+            .totalTravelTime;
+        if (fastTravelTime < slowTravelTime) {
+            stationB = station;
+            break;
+        }
+    }
+    BOOST_REQUIRE(stationB != 0);
+
+    // Indexed queries pair each graph with its own penalty.
+    std::atomic<bool> done {false};
+    std::atomic<size_t> nWrongTravelTimes {0};
+    std::vector<std::thread> readers {};
+    for (size_t idx {0}; idx < 4; ++idx) {
+        readers.emplace_back([&, &nw = nw]() {
+            while (!done) {
+                const auto travelTime {
+                    nw.GetFastestTravelRoute(stationA, stationB)
+                        .totalTravelTime
+                };
+                if (travelTime != slowTravelTime &&
+                    travelTime != fastTravelTime) {
+                    ++nWrongTravelTimes;
+                }
+            }
+        });
+    }
+    for (size_t idx {0}; idx < 10; ++idx) {
+        nw.SetRouteChangePenalty(idx % 2 == 0 ? 0 : 5);
+    }
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    BOOST_CHECK_EQUAL(nWrongTravelTimes.load(), 0);
+    BOOST_CHECK_EQUAL(nw.GetRouteChangePenalty(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(batch, *timeout {10})
+{
+    auto [nw, _] = GetTestNetwork("ltc_path1", true);
+    nw.SetBatchQueryThreads(4);
+
+    // The routes come back in the order of the queries.
+    std::vector<std::pair<StationHandle, StationHandle>> queries {};
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 7) {
+        for (StationHandle stationB {3}; stationB < nStations; stationB += 11) {
+            queries.push_back({stationA, stationB});
+        }
+    }
+    const auto travelRoutes {nw.GetFastestTravelRoutes(queries)};
+    BOOST_REQUIRE_EQUAL(travelRoutes.size(), queries.size());
+    for (size_t idx {0}; idx < queries.size(); ++idx) {
+        BOOST_CHECK_EQUAL(
+            travelRoutes[idx],
+            nw.GetFastestTravelRoute(queries[idx].first, queries[idx].second)
+        );
+    }
+
+    // Networks with no pool of their own share one, across batches.
+    auto nwDefaultPool {GetTestNetwork("ltc_path1", true).first};
+    for (size_t idx {0}; idx < 2; ++idx) {
+        BOOST_CHECK(
+            nwDefaultPool.GetFastestTravelRoutes(queries) == travelRoutes
+        );
+    }
+
+    // Same with station IDs.
+    const auto travelRoutesById {nw.GetFastestTravelRoutes(
+        std::vector<std::pair<Id, Id>> {
+            {"station_003", "station_019"},
+            {"station_211", "station_119"},
+            {"station_003", "not_a_station"},
+        }
+    )};
+    BOOST_REQUIRE_EQUAL(travelRoutesById.size(), 3);
+    BOOST_CHECK_EQUAL(
+        travelRoutesById[0],
+        nw.GetFastestTravelRoute("station_003", "station_019")
+    );
+    BOOST_CHECK_EQUAL(
+        travelRoutesById[1],
+        nw.GetFastestTravelRoute("station_211", "station_119")
+    );
+    BOOST_CHECK_EQUAL(travelRoutesById[2], TravelRoute {});
+}
+
+BOOST_AUTO_TEST_CASE(travel_time_matrix, *timeout {10})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork("ltc_path1", true);
+    auto [nwPrecomputed, _] = GetTestNetwork("ltc_path1", true);
+    nwPrecomputed.PrecomputeFastestTravelRoutes();
+
+    // Each matrix cell has the travel time of the fastest route.
+    std::vector<StationHandle> sources {};
+    std::vector<StationHandle> targets {};
+    const StationHandle nStations {426};
+    for (StationHandle station {0}; station < nStations; station += 7) {
+        sources.push_back(station);
+    }
+    for (StationHandle station {3}; station < nStations; station += 11) {
+        targets.push_back(station);
+    }
+    targets.push_back(3);
+    targets.push_back(NetworkMonitor::kInvalidStationHandle);
+    sources.push_back(NetworkMonitor::kInvalidStationHandle);
+    const auto matrix {nw.GetTravelTimeMatrix(sources, targets)};
+    BOOST_REQUIRE_EQUAL(matrix.size(), sources.size() * targets.size());
+    BOOST_CHECK(
+        nwPrecomputed.GetTravelTimeMatrix(sources, targets) == matrix
+    );
+    for (size_t row {0}; row < sources.size(); ++row) {
+        for (size_t column {0}; column < targets.size(); ++column) {
+            const auto travelTime {matrix[row * targets.size() + column]};
+            const auto travelRoute {nw.GetFastestTravelRoute(
+                sources[row],
+                targets[column]
+            )};
+            if (travelRoute.steps.empty()) {
+                BOOST_CHECK_EQUAL(
+                    travelTime,
+                    NetworkMonitor::kUnreachableTravelTime
+                );
+            } else {
+                BOOST_CHECK_EQUAL(travelTime, travelRoute.totalTravelTime);
+            }
+        }
+    }
+
+    // Same with station IDs.
+    BOOST_CHECK(nw.GetTravelTimeMatrix(
+        std::vector<Id> {"station_003", "station_211"},
+        std::vector<Id> {"station_019", "station_119"}
+    ) == std::vector<unsigned int>({
+        nw.GetFastestTravelRoute("station_003", "station_019").totalTravelTime,
+        nw.GetFastestTravelRoute("station_003", "station_119").totalTravelTime,
+        nw.GetFastestTravelRoute("station_211", "station_019").totalTravelTime,
+        nw.GetFastestTravelRoute("station_211", "station_119").totalTravelTime,
+    }));
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // GetFastestTravelRoute
 
 BOOST_AUTO_TEST_SUITE(GetQuietTravelRoute);
@@ -1023,6 +2146,22 @@ BOOST_AUTO_TEST_CASE(ltc_path2, *timeout {5})
     BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
 }
 
+BOOST_AUTO_TEST_CASE(station_handles, *timeout {1})
+{
+    double maxSlowdownPc {0.1};
+    double minQuietnessPc {0.1};
+    size_t maxNPaths {20};
+    auto [nw, resultTravelRoute] = GetTestNetwork("ltc_path1", true);
+    auto travelRoute {nw.GetQuietTravelRoute(
+        nw.LookupStation("station_003"),
+        nw.LookupStation("station_019"),
+        maxSlowdownPc,
+        minQuietnessPc,
+        maxNPaths
+    )};
+    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
+}
+
 BOOST_AUTO_TEST_CASE(network_quiet_path_2routes, *timeout {1})
 {
     // Network under test:
@@ -1196,12 +2335,12 @@ BOOST_AUTO_TEST_CASE(ltc_quiet2, *timeout {5})
         BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
     }
 
-    // A 10% crowding improvement is possible via route_049.
+    // A 10% crowding improvement is possible via route_050.
     {
         double maxSlowdownPc {0.1};
         double minQuietnessPc {0.1};
             auto [nw, resultTravelRoute] = GetTestNetwork(
-                "ltc_quiet2", true, true, "route_049"
+                "ltc_quiet2", true, true, "route_050"
             );
         auto travelRoute {nw.GetQuietTravelRoute(
             "station_211",
@@ -1214,8 +2353,607 @@ BOOST_AUTO_TEST_CASE(ltc_quiet2, *timeout {5})
     }
 }
 
+BOOST_AUTO_TEST_CASE(distinct_paths, *timeout {5})
+{
+    // Many spur searches on this trip find paths we already found. We only
+    // count each path once, so without a limit on the number of paths the
+    // search ends when it runs out of new paths within the travel time limit,
+    // and any limit past that number gives the same route.
+    auto [nw, resultTravelRoute] = GetTestNetwork(
+        "ltc_quiet2", true, true, "route_050"
+    );
+    const auto travelRoute {nw.GetQuietTravelRoute(
+        "station_211",
+        "station_119",
+        0.1,
+        0.1
+    )};
+    BOOST_CHECK_EQUAL(travelRoute, resultTravelRoute);
+    for (const size_t maxNPaths: {20, 100, 1000}) {
+        BOOST_CHECK_EQUAL(
+            nw.GetQuietTravelRoute(
+                "station_211",
+                "station_119",
+                0.1,
+                0.1,
+                maxNPaths
+            ),
+            travelRoute
+        );
+    }
+}
+
+BOOST_AUTO_TEST_CASE(travel_time_limit, *timeout {1})
+{
+    // Network under test:
+    //
+    // Route 0: [A]--5--[X]--5--[B]
+    // Route 1: [A]--6--[Y]--6--[B]
+    // Route 2: [A]--7--[Z]--6--[B]
+    //
+    // The slower the route, the more quiet it is. We only look for paths
+    // within the travel time limit, so a route exactly at the limit must
+    // still be found, and a route just past it must not.
+    TransportNetwork nw {};
+    bool ok {true};
+    for (const auto& idx: {"A", "X", "Y", "Z", "B"}) {
+        ok &= nw.AddStation({
+            std::string {"station_"} + idx,
+            std::string {"Station Name "} + idx,
+        });
+    }
+    BOOST_REQUIRE(ok);
+    for (const auto& [idx, stationId]: std::vector<std::pair<Id, Id>> {
+        {"0", "station_X"},
+        {"1", "station_Y"},
+        {"2", "station_Z"},
+    }) {
+        const Id lineId {"line_" + idx};
+        ok &= nw.AddLine({
+            lineId,
+            "Line Name",
+            {{
+                "route_" + idx,
+                "inbound",
+                lineId,
+                "station_A",
+                "station_B",
+                {"station_A", stationId, "station_B"},
+            }},
+        });
+    }
+    ok &= nw.SetTravelTime("station_A", "station_X", 5);
+    ok &= nw.SetTravelTime("station_X", "station_B", 5);
+    ok &= nw.SetTravelTime("station_A", "station_Y", 6);
+    ok &= nw.SetTravelTime("station_Y", "station_B", 6);
+    ok &= nw.SetTravelTime("station_A", "station_Z", 7);
+    ok &= nw.SetTravelTime("station_Z", "station_B", 6);
+    BOOST_REQUIRE(ok);
+    using EventType = PassengerEvent::Type;
+    for (size_t idx {0}; idx < 10; ++idx) {
+        ok &= nw.RecordPassengerEvent({"station_X", EventType::In});
+    }
+    for (size_t idx {0}; idx < 5; ++idx) {
+        ok &= nw.RecordPassengerEvent({"station_Y", EventType::In});
+    }
+    BOOST_REQUIRE(ok);
+
+    // The Pareto search considers all routes within the travel time limit, so
+    // the Yen search must pick the same route.
+    auto checkRoute {[&nw](
+        const double maxSlowdownPc,
+        const Id& routeId,
+        const unsigned int travelTime
+    ) {
+        for (const auto search: {
+            QuietRouteSearch::kYen,
+            QuietRouteSearch::kPareto,
+        }) {
+            const auto travelRoute {nw.GetQuietTravelRoute(
+                "station_A",
+                "station_B",
+                maxSlowdownPc,
+                0.1,
+                20,
+                search
+            )};
+            BOOST_CHECK_EQUAL(travelRoute.totalTravelTime, travelTime);
+            BOOST_REQUIRE_EQUAL(travelRoute.steps.size(), 2);
+            for (const auto& step: travelRoute.steps) {
+                BOOST_CHECK_EQUAL(step.routeId, routeId);
+            }
+        }
+    }};
+    checkRoute(0.1, "route_0", 10);  // Limit: 11
+    checkRoute(0.25, "route_1", 12); // Limit: 12
+    checkRoute(0.3, "route_2", 13);  // Limit: 13
+}
+
+BOOST_AUTO_TEST_CASE(parallel, *timeout {10})
+{
+    auto [nw, _] = GetTestNetwork("ltc_quiet2", true, true, "route_053");
+    TransportNetwork nwParallel {nw};
+    nwParallel.SetQuietRouteSearchThreads(4);
+
+    // We compare the two search modes on a sample of station pairs.
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 37) {
+        for (StationHandle stationB {5}; stationB < nStations;
+             stationB += 41) {
+            BOOST_CHECK_EQUAL(
+                nwParallel.GetQuietTravelRoute(stationA, stationB, 0.1, 0.1, 20),
+                nw.GetQuietTravelRoute(stationA, stationB, 0.1, 0.1, 20)
+            );
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(searches, *timeout {10})
+{
+    auto [nw, _] = GetTestNetwork("ltc_quiet2", true, true, "route_053");
+    auto getCrowding {[&nw = nw](const TravelRoute& travelRoute) {
+        long long int crowding {nw.GetPassengerCount(
+            travelRoute.startStationId
+        )};
+        for (const auto& step: travelRoute.steps) {
+            crowding += nw.GetPassengerCount(step.endStationId);
+        }
+        return crowding;
+    }};
+
+    // The Pareto search considers all routes within the travel time limit, so
+    // it finds routes at least as quiet as the other searches do.
+    const double maxSlowdownPc {0.2};
+    const double minQuietnessPc {0.1};
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 37) {
+        for (StationHandle stationB {5}; stationB < nStations;
+             stationB += 41) {
+            const auto fastestRoute {
+                nw.GetFastestTravelRoute(stationA, stationB)
+            };
+            const auto yenRoute {nw.GetQuietTravelRoute(
+                stationA,
+                stationB,
+                maxSlowdownPc,
+                minQuietnessPc,
+                20
+            )};
+            const auto paretoRoute {nw.GetQuietTravelRoute(
+                stationA,
+                stationB,
+                maxSlowdownPc,
+                minQuietnessPc,
+                20,
+                QuietRouteSearch::kPareto
+            )};
+            const auto lagrangianRoute {nw.GetQuietTravelRoute(
+                stationA,
+                stationB,
+                maxSlowdownPc,
+                minQuietnessPc,
+                20,
+                QuietRouteSearch::kLagrangian
+            )};
+            for (const auto& travelRoute: {paretoRoute, lagrangianRoute}) {
+                BOOST_CHECK_EQUAL(travelRoute.steps.empty(),
+                                  fastestRoute.steps.empty());
+                BOOST_CHECK(travelRoute.totalTravelTime <=
+                            fastestRoute.totalTravelTime *
+                                (1 + maxSlowdownPc));
+                BOOST_CHECK(getCrowding(travelRoute) <=
+                            getCrowding(fastestRoute));
+            }
+            BOOST_CHECK(getCrowding(paretoRoute) <= getCrowding(yenRoute));
+            BOOST_CHECK(getCrowding(paretoRoute) <=
+                        getCrowding(lagrangianRoute));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(batch, *timeout {10})
+{
+    auto [nw, _] = GetTestNetwork("ltc_quiet2", true, true, "route_053");
+
+    // The routes come back in the order of the queries.
+    std::vector<std::pair<StationHandle, StationHandle>> queries {};
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 37) {
+        for (StationHandle stationB {5}; stationB < nStations;
+             stationB += 41) {
+            queries.push_back({stationA, stationB});
+        }
+    }
+    const auto travelRoutes {
+        nw.GetQuietTravelRoutes(queries, 0.1, 0.1, 20)
+    };
+    BOOST_REQUIRE_EQUAL(travelRoutes.size(), queries.size());
+    for (size_t idx {0}; idx < queries.size(); ++idx) {
+        BOOST_CHECK_EQUAL(
+            travelRoutes[idx],
+            nw.GetQuietTravelRoute(
+                queries[idx].first,
+                queries[idx].second,
+                0.1,
+                0.1,
+                20
+            )
+        );
+    }
+}
+
+BOOST_AUTO_TEST_CASE(route_cache, *timeout {10})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork(
+        "ltc_quiet2", true, true, "route_053"
+    );
+    nw.SetRouteCacheCapacity(2);
+    const auto getQuietTravelRoute {[&nw = nw]() {
+        return nw.GetQuietTravelRoute(
+            "station_003",
+            "station_019",
+            0.1,
+            0.1,
+            20
+        );
+    }};
+
+    // Repeated queries hit the cache and return the same routes.
+    const auto fastestTravelRoute {
+        nw.GetFastestTravelRoute("station_003", "station_019")
+    };
+    const auto quietTravelRoute {getQuietTravelRoute()};
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 0);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 2);
+    BOOST_CHECK_EQUAL(
+        nw.GetFastestTravelRoute("station_003", "station_019"),
+        fastestTravelRoute
+    );
+    BOOST_CHECK_EQUAL(getQuietTravelRoute(), quietTravelRoute);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 2);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 2);
+
+    // Passenger events only invalidate the quiet routes.
+    using EventType = PassengerEvent::Type;
+    BOOST_REQUIRE(nw.RecordPassengerEvent({"station_003", EventType::In}));
+    nw.GetFastestTravelRoute("station_003", "station_019");
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 3);
+    getQuietTravelRoute();
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 3);
+
+    // Network changes invalidate all routes.
+    nw.SetRouteChangePenalty(nw.GetRouteChangePenalty());
+    nw.GetFastestTravelRoute("station_003", "station_019");
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 4);
+
+    // The least recently used route makes room for new ones.
+    getQuietTravelRoute();
+    nw.GetFastestTravelRoute("station_019", "station_003");
+    nw.GetFastestTravelRoute("station_003", "station_019");
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 3);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(route_cache_tolerance, *timeout {10})
+{
+    auto [nw, resultTravelRoute] = GetTestNetwork(
+        "ltc_quiet2", true, true, "route_053"
+    );
+    nw.SetRouteCacheCapacity(1);
+    nw.SetQuietRouteCrowdingTolerance(0.5);
+    const auto getQuietTravelRoute {[&nw = nw]() {
+        return nw.GetQuietTravelRoute(
+            "station_211",
+            "station_119",
+            0.1,
+            0.1,
+            20
+        );
+    }};
+    const auto quietTravelRoute {getQuietTravelRoute()};
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 1);
+
+    // Small crowding changes keep the cached route.
+    using EventType = PassengerEvent::Type;
+    BOOST_REQUIRE(nw.RecordPassengerEvent({"station_211", EventType::In}));
+    BOOST_CHECK_EQUAL(getQuietTravelRoute(), quietTravelRoute);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 1);
+
+    // Station A is on all candidate paths, so their crowding has changed by
+    // more than 5%.
+    nw.SetQuietRouteCrowdingTolerance(0.05);
+    getQuietTravelRoute();
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 1);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 2);
+
+    // The tolerance does not apply to the other searches.
+    nw.SetQuietRouteCrowdingTolerance(0.5);
+    const auto getParetoQuietTravelRoute {[&nw = nw]() {
+        return nw.GetQuietTravelRoute(
+            "station_211",
+            "station_119",
+            0.1,
+            0.1,
+            20,
+            QuietRouteSearch::kPareto
+        );
+    }};
+    getParetoQuietTravelRoute();
+    BOOST_REQUIRE(nw.RecordPassengerEvent({"station_211", EventType::In}));
+    getParetoQuietTravelRoute();
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheHits(), 1);
+    BOOST_CHECK_EQUAL(nw.GetRouteCacheMisses(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(route_crowding, *timeout {1})
+{
+    // Network under test:
+    //
+    // Route 0: [A]--1--[0]--1--[B]
+    // Route 1: [A]--1--[0]--1--[B]
+    //
+    // The two routes are on different lines and share all their stations, so
+    // only the passenger events on each route tell them apart.
+    TransportNetwork nw {};
+    bool ok {true};
+    ok &= nw.AddStation({"station_A", "Station Name A"});
+    ok &= nw.AddStation({"station_0", "Station Name 0"});
+    ok &= nw.AddStation({"station_B", "Station Name B"});
+    BOOST_REQUIRE(ok);
+    for (const auto& idx: {"0", "1"}) {
+        const Id lineId {std::string {"line_"} + idx};
+        const Id routeId {std::string {"route_"} + idx};
+        ok &= nw.AddLine({
+            lineId,
+            "Line Name",
+            {{
+                routeId,
+                "inbound",
+                lineId,
+                "station_A",
+                "station_B",
+                {"station_A", "station_0", "station_B"},
+            }},
+        });
+    }
+    ok &= nw.SetTravelTime("station_A", "station_0", 1);
+    ok &= nw.SetTravelTime("station_0", "station_B", 1);
+    BOOST_REQUIRE(ok);
+
+    // All steps of the route ride the same route.
+    auto checkRoute {[&nw](const Id& routeId) {
+        for (const auto search: {
+            QuietRouteSearch::kYen,
+            QuietRouteSearch::kPareto,
+            QuietRouteSearch::kLagrangian,
+        }) {
+            const auto travelRoute {nw.GetQuietTravelRoute(
+                "station_A",
+                "station_B",
+                0.1,
+                0.1,
+                20,
+                search
+            )};
+            BOOST_REQUIRE_EQUAL(travelRoute.steps.size(), 2);
+            for (const auto& step: travelRoute.steps) {
+                BOOST_CHECK_EQUAL(step.routeId, routeId);
+            }
+        }
+    }};
+
+    using EventType = PassengerEvent::Type;
+    for (size_t idx {0}; idx < 5; ++idx) {
+        ok &= nw.RecordPassengerEvent({
+            "station_0", EventType::In, {}, "route_0"
+        });
+    }
+    BOOST_REQUIRE(ok);
+    checkRoute("route_1");
+
+    // We count the first stop on the route we board there.
+    for (size_t idx {0}; idx < 10; ++idx) {
+        ok &= nw.RecordPassengerEvent({
+            "station_A", EventType::In, {}, "route_1"
+        });
+    }
+    BOOST_REQUIRE(ok);
+    checkRoute("route_0");
+
+    // The events with no route count on all routes.
+    for (size_t idx {0}; idx < 20; ++idx) {
+        ok &= nw.RecordPassengerEvent({"station_B", EventType::In});
+    }
+    BOOST_REQUIRE(ok);
+    checkRoute("route_0");
+}
+
+BOOST_AUTO_TEST_CASE(decayed_crowding, *timeout {10})
+{
+    // The passenger counts of this test happen at time 0.
+    auto [nw, resultTravelRoute] = GetTestNetwork(
+        "ltc_quiet2", true, true, "route_050"
+    );
+    auto [nwEmpty, fastestTravelRoute] = GetTestNetwork(
+        "ltc_quiet2", true, false, "route_053"
+    );
+    const auto getQuietTravelRoute {[&nw = nw](const CrowdingModel model) {
+        return nw.GetQuietTravelRoute(
+            "station_211",
+            "station_119",
+            0.1,
+            0.1,
+            20,
+            QuietRouteSearch::kYen,
+            model
+        );
+    }};
+    BOOST_CHECK_EQUAL(
+        getQuietTravelRoute(CrowdingModel::kDecayed),
+        resultTravelRoute
+    );
+
+    // Move the clock forward with an event that does not add any crowding.
+    // The old events are forgotten.
+    using EventType = PassengerEvent::Type;
+    using boost::posix_time::hours;
+    using boost::posix_time::minutes;
+    const boost::posix_time::ptime now {boost::gregorian::date {2024, 1, 1}};
+    BOOST_REQUIRE(nw.RecordPassengerEvent({
+        "station_300", EventType::Out, now
+    }));
+    BOOST_CHECK_EQUAL(
+        getQuietTravelRoute(CrowdingModel::kCumulative),
+        resultTravelRoute
+    );
+    BOOST_CHECK_EQUAL(
+        getQuietTravelRoute(CrowdingModel::kDecayed),
+        fastestTravelRoute
+    );
+
+    // Recent events count in full.
+    for (size_t idx {0}; idx < 9; ++idx) {
+        BOOST_REQUIRE(nw.RecordPassengerEvent({
+            "station_211", EventType::In, now
+        }));
+    }
+    BOOST_REQUIRE(nw.RecordPassengerEvent({
+        "station_022", EventType::In, now
+    }));
+    BOOST_CHECK_EQUAL(
+        getQuietTravelRoute(CrowdingModel::kDecayed),
+        resultTravelRoute
+    );
+
+    // After 4 half-lives, the events count for 1/16 of a passenger.
+    BOOST_REQUIRE(nw.RecordPassengerEvent({
+        "station_300", EventType::Out, now + minutes(60)
+    }));
+    BOOST_CHECK_EQUAL(
+        getQuietTravelRoute(CrowdingModel::kDecayed),
+        fastestTravelRoute
+    );
+    nw.SetCrowdingHalfLife(hours(100));
+    BOOST_CHECK_EQUAL(
+        getQuietTravelRoute(CrowdingModel::kDecayed),
+        resultTravelRoute
+    );
+}
+
+BOOST_AUTO_TEST_CASE(passenger_events, *timeout {20})
+{
+    auto [nw, _] = GetTestNetwork("ltc_quiet2", true, false, "route_053");
+
+    // Record events on some threads while others search quiet routes.
+    using EventType = PassengerEvent::Type;
+    const size_t nEvents {10000};
+    std::atomic<bool> done {false};
+    std::vector<std::thread> readers {};
+    for (size_t idx {0}; idx < 2; ++idx) {
+        readers.emplace_back([&nw = nw, &done]() {
+            while (!done) {
+                nw.GetQuietTravelRoute(
+                    "station_211",
+                    "station_119",
+                    0.1,
+                    0.1,
+                    20,
+                    QuietRouteSearch::kPareto
+                );
+            }
+        });
+    }
+    std::vector<std::thread> writers {};
+    for (size_t idx {0}; idx < 2; ++idx) {
+        writers.emplace_back([&nw = nw, idx]() {
+            for (size_t event {0}; event < nEvents; ++event) {
+                nw.RecordPassengerEvent({"station_211", EventType::In});
+                nw.RecordPassengerEvent({"station_022", EventType::Out});
+            }
+        });
+    }
+    for (auto& writer: writers) {
+        writer.join();
+    }
+    done = true;
+    for (auto& reader: readers) {
+        reader.join();
+    }
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_211"), 2 * nEvents);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_022"), -2 * nEvents);
+
+    // New stations do not reset the counts.
+    BOOST_REQUIRE(nw.AddStation({"station_new", "New Station"}));
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_211"), 2 * nEvents);
+    BOOST_CHECK_EQUAL(nw.GetPassengerCount("station_new"), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END(); // GetQuietTravelRoute
 
+BOOST_AUTO_TEST_SUITE(GetReachableStations);
+
+BOOST_AUTO_TEST_CASE(isochrone, *timeout {10})
+{
+    auto [nw, _] = GetTestNetwork("ltc_path1", true);
+
+    // We find exactly the stations whose fastest route is within the budget,
+    // in order of travel time.
+    const unsigned int maxTravelTime {20};
+    const StationHandle nStations {426};
+    for (StationHandle stationA {0}; stationA < nStations; stationA += 53) {
+        const auto reachableStations {
+            nw.GetReachableStations(stationA, maxTravelTime)
+        };
+        BOOST_REQUIRE(!reachableStations.empty());
+        BOOST_CHECK_EQUAL(
+            reachableStations.front().stationId,
+            nw.GetStationId(stationA)
+        );
+        BOOST_CHECK_EQUAL(reachableStations.front().travelTime, 0);
+        std::unordered_map<Id, ReachableStation> reachableById {};
+        for (size_t idx {0}; idx < reachableStations.size(); ++idx) {
+            const auto& reachable {reachableStations[idx]};
+            if (idx > 0) {
+                BOOST_CHECK(reachableStations[idx - 1].travelTime <=
+                            reachable.travelTime);
+            }
+            reachableById[reachable.stationId] = reachable;
+        }
+        BOOST_CHECK_EQUAL(reachableById.size(), reachableStations.size());
+        for (StationHandle stationB {0}; stationB < nStations; ++stationB) {
+            const auto travelRoute {
+                nw.GetFastestTravelRoute(stationA, stationB)
+            };
+            const auto reachableIt {
+                reachableById.find(nw.GetStationId(stationB))
+            };
+            if (travelRoute.steps.empty() ||
+                travelRoute.totalTravelTime > maxTravelTime) {
+                BOOST_CHECK(reachableIt == reachableById.end());
+                continue;
+            }
+            BOOST_REQUIRE(reachableIt != reachableById.end());
+            BOOST_CHECK_EQUAL(
+                reachableIt->second.travelTime,
+                travelRoute.totalTravelTime
+            );
+
+            // The fastest route may not have the fewest route changes.
+            unsigned int nRouteChanges {0};
+            for (size_t idx {1}; idx < travelRoute.steps.size(); ++idx) {
+                nRouteChanges += travelRoute.steps[idx].routeId !=
+                                 travelRoute.steps[idx - 1].routeId;
+            }
+            BOOST_CHECK(reachableIt->second.nRouteChanges <= nRouteChanges);
+        }
+    }
+
+    // Invalid station
+    BOOST_CHECK(nw.GetReachableStations("not_a_station", 10).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END(); // GetReachableStations
+
 BOOST_AUTO_TEST_SUITE_END(); // Routes
 
 BOOST_AUTO_TEST_SUITE_END(); // class_TransportNetwork